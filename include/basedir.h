@@ -43,12 +43,14 @@
 #ifndef XDG_BASEDIR_H
 #define XDG_BASEDIR_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /** Version of XDG Base Directory specification implemented in this library. */
-#define XDG_BASEDIR_SPEC 0.7
+#define XDG_BASEDIR_SPEC 0.8
 
 /** @name XDG data cache management */
 /*@{*/
@@ -61,26 +63,312 @@ typedef struct /*_xdgHandle*/ {
 	void *reserved;
 } xdgHandle;
 
+/** Classes of base directories, for xdgHome(), xdgSearchableDirectories()
+  * and xdgFind(). Every class has a home directory, and data and config
+  * also have further directories to search. */
+typedef enum /*_xdgDirectoryClass*/ {
+	/** $XDG_DATA_HOME and $XDG_DATA_DIRS. */
+	XDG_DATA,
+	/** $XDG_CONFIG_HOME and $XDG_CONFIG_DIRS. */
+	XDG_CONFIG,
+	/** $XDG_CACHE_HOME. */
+	XDG_CACHE,
+	/** $XDG_STATE_HOME. */
+	XDG_STATE,
+	/** $XDG_RUNTIME_DIR, which may be unset. */
+	XDG_RUNTIME
+} xdgDirectoryClass;
+
 /** Initialize a handle to an XDG data cache and initialize the cache.
   * Use xdgWipeHandle() to free the handle.
   * @return a pointer to the handle if initialization was successful, else 0 */
 xdgHandle * xdgInitHandle(xdgHandle *handle);
 
+/** Flags for xdgInitHandleEx(). */
+enum
+{
+	/** Keep a file descriptor open for every searchable directory and
+	  * resolve relative paths against it with openat(2) and friends,
+	  * instead of having the kernel walk the full path on every lookup.
+	  * Directories that cannot be opened when the cache is built are
+	  * searched by path as usual. */
+	XDG_HANDLE_DIRFDS = 1 << 0,
+	/** Remember the results of xdgDataFind(), xdgConfigFind() and their
+	  * variants, including empty ones, and answer repeated queries from
+	  * memory. The cache is flushed when xdgUpdateData() rebuilds the
+	  * data cache and by xdgFlushLookupCache(); see also
+	  * xdgSetLookupCacheTTL(). */
+	XDG_HANDLE_LOOKUP_CACHE = 1 << 1,
+	/** Like @c XDG_HANDLE_LOOKUP_CACHE, but additionally watch the
+	  * searched directories with inotify(7) and flush cached results
+	  * when one of them changes, see xdgEventFd(). Where inotify is not
+	  * available this is the same as @c XDG_HANDLE_LOOKUP_CACHE. */
+	XDG_HANDLE_WATCH = 1 << 2,
+	/** Allow the handle to be used by several threads at once, while
+	  * one of them calls xdgUpdateData(). Lookups never wait for an
+	  * update in progress; instead the update waits for lookups still
+	  * using the old data before freeing it. Strings and lists returned
+	  * by the query functions must be used between xdgBeginRead() and
+	  * xdgEndRead(). Cannot be combined with @c XDG_HANDLE_LOOKUP_CACHE
+	  * or @c XDG_HANDLE_WATCH. */
+	XDG_HANDLE_CONCURRENT = 1 << 3,
+	/** Like @c XDG_HANDLE_LOOKUP_CACHE, but additionally keep lookup
+	  * results in an index file below xdgCacheHome(), which later handles
+	  * with the same search directories map into memory. Indexed results
+	  * are used without probing as long as the device, inode and
+	  * modification time of the directories they depend on are unchanged.
+	  * Changes to file permissions alone are not noticed. The index is
+	  * written by xdgSaveIndex(), xdgWipeHandle() and xdgUpdateData()
+	  * when it rebuilds the data cache.
+	  * Cannot be combined with @c XDG_HANDLE_CONCURRENT. */
+	XDG_HANDLE_INDEX = 1 << 4,
+	/** Read the subdirectory holding a looked-up path once in every
+	  * searchable directory, and answer later lookups under the same
+	  * subdirectory from memory. Only directories listing the name are
+	  * probed, and not even those if @c XDG_FIND_EXISTS is all that is
+	  * asked for. Listings are flushed along with cached lookup results,
+	  * see xdgFlushLookupCache(). Cannot be combined with
+	  * @c XDG_HANDLE_CONCURRENT. */
+	XDG_HANDLE_LISTINGS = 1 << 5,
+	/** Remove repeated separators, trailing separators and "." components
+	  * from the searchable directories, and drop directories that name
+	  * the same path or, according to stat(2), the same directory as an
+	  * earlier one. The home directories are left as they are and stay
+	  * first. */
+	XDG_HANDLE_DEDUPE = 1 << 6,
+	/** Drop searchable directories that are not existing directories
+	  * when the cache is built by xdgInitHandleEx() or xdgUpdateData(),
+	  * so later lookups do not probe them. Directories created afterwards
+	  * are only searched after the next xdgUpdateData(). The home
+	  * directories are always kept. */
+	XDG_HANDLE_PRUNE_MISSING = 1 << 7
+};
+
+/** Initialize a handle to an XDG data cache with extra options.
+  * The flags are kept when the cache is rebuilt by xdgUpdateData().
+  * Use xdgWipeHandle() to free the handle.
+  * @param handle Handle to be initialized.
+  * @param flags Bitwise or of @c XDG_HANDLE_* flags.
+  * @return a pointer to the handle if initialization was successful, else 0 */
+xdgHandle * xdgInitHandleEx(xdgHandle *handle, int flags);
+
+/** Values to build a handle from instead of the environment, see
+  * xdgInitHandleFromValues() and xdgCloneHandle(). Members left NULL
+  * are not set. */
+typedef struct /*_xdgHandleValues*/ {
+	/** User home directory, like @c $HOME. Home directories that are not
+	  * given are the default ones relative to it. */
+	const char *home;
+	/** Home directories indexed by xdgDirectoryClass, like @c $XDG_DATA_HOME. */
+	const char *homes[XDG_RUNTIME+1];
+	/** @c $PATH style directory lists indexed by xdgDirectoryClass, like
+	  * @c $XDG_DATA_DIRS. Only used for data and config. */
+	const char *directories[XDG_RUNTIME+1];
+} xdgHandleValues;
+
+/** Initialize a handle to an XDG data cache from explicit values.
+  * The environment is never read, also not by xdgUpdateData(), and
+  * directory lists not given are the defaults.
+  * Use xdgWipeHandle() to free the handle.
+  * @param handle Handle to be initialized.
+  * @param flags Bitwise or of @c XDG_HANDLE_* flags.
+  * @param values Values to use, copied into the handle.
+  * @return a pointer to the handle if initialization was successful, else 0
+  * 	with errno set to @c EINVAL if a default home directory is needed
+  * 	but values has no user home. */
+xdgHandle * xdgInitHandleFromValues(xdgHandle *handle, int flags, const xdgHandleValues *values);
+
+/** Initialize a handle sharing the data cache of another one.
+  * The clone has the flags of handle and empty lookup caches. Without
+  * overrides it refers to the cache of handle, so that cloning takes
+  * constant time and memory. Otherwise only the directory classes named
+  * by overrides are rebuilt, the others are shared; values overrides
+  * leaves unset, such as the directory list of a class whose home it
+  * sets, are taken from handle. The caches stay valid when either
+  * handle is updated or wiped. xdgUpdateData() rebuilds the clone as
+  * it would handle, but always with the overrides.
+  * Use xdgWipeHandle() to free the clone.
+  * @param clone Handle to be initialized.
+  * @param handle Initialized handle to clone.
+  * @param overrides Values replacing those of handle, or NULL.
+  * @return a pointer to clone if initialization was successful, else 0 */
+xdgHandle * xdgCloneHandle(xdgHandle *clone, xdgHandle *handle, const xdgHandleValues *overrides);
+
 /** Wipe handle of XDG data cache.
   * Wipe handle initialized using xdgInitHandle(). */
 void xdgWipeHandle(xdgHandle *handle);
 
+/** Successful results of xdgUpdateData(). */
+enum
+{
+	/** The data cache was rebuilt, and lookup caches were flushed. */
+	XDG_UPDATE_REBUILT = 1,
+	/** The values the data cache was built from are unchanged, so it
+	  * was kept along with the lookup caches. Never returned for handles
+	  * with @c XDG_HANDLE_DIRFDS, @c XDG_HANDLE_DEDUPE or
+	  * @c XDG_HANDLE_PRUNE_MISSING. */
+	XDG_UPDATE_UNCHANGED = 2
+};
+
 /** Update the data cache.
-  * This should not be done frequently as it reallocates the cache.
+  * If the environment variables, or the values of handles initialized
+  * with xdgInitHandleFromValues(), are the same as when the cache was
+  * built, nothing is done. Caches of handles with @c XDG_HANDLE_DIRFDS,
+  * @c XDG_HANDLE_DEDUPE or @c XDG_HANDLE_PRUNE_MISSING depend on the
+  * file system and are always rebuilt, so that directories replaced or
+  * created since are opened again, like those of clones with overrides
+  * the first time they are updated.
   * Even if updating the cache fails the handle remains valid and can
   * be used to access XDG data as it was before xdgUpdateData() was called.
-  * @return 0 if update failed, non-0 if successful.*/
+  * @return 0 if update failed, else @c XDG_UPDATE_REBUILT or
+  * 	@c XDG_UPDATE_UNCHANGED. */
 int xdgUpdateData(xdgHandle *handle);
 
+/** Start using data of a handle initialized with @c XDG_HANDLE_CONCURRENT.
+  * Until the matching xdgEndRead(), strings and lists returned by the
+  * query functions remain valid even if another thread calls
+  * xdgUpdateData(), though separate calls may return data of different
+  * updates. Sections may be nested and never block. For other
+  * handles this does nothing.
+  * @param handle Handle to data cache, initialized with xdgInitHandleEx().
+  * @return A ticket to pass to xdgEndRead(). */
+int xdgBeginRead(xdgHandle *handle);
+
+/** End a section started with xdgBeginRead().
+  * @param handle Handle to data cache, initialized with xdgInitHandleEx().
+  * @param ticket Value returned by the matching xdgBeginRead(). */
+void xdgEndRead(xdgHandle *handle, int ticket);
+
+/** Get a handle shared by all users of the library in the process.
+  * The handle is initialized from the environment on the first call
+  * and is never wiped, so strings and lists returned for it need not
+  * be freed. Where supported it is a @c XDG_HANDLE_CONCURRENT handle;
+  * code calling xdgUpdateData() on it must expect other users to
+  * bracket their reads with xdgBeginRead() and xdgEndRead().
+  * @return the shared handle, or 0 if it could not be initialized. */
+xdgHandle * xdgDefaultHandle(void);
+
+/*@}*/
+
+/** @name Usage statistics
+  * Only available if the library was configured with @c --enable-stats. */
+/*@{*/
+
+/** Process-wide usage counters, see xdgGetStats(). */
+typedef struct /*_xdgStats*/ {
+	/** Find and open calls in data directories, one per path for batches. */
+	unsigned long dataLookups;
+	/** Find and open calls in config directories, one per path for batches. */
+	unsigned long configLookups;
+	/** Find and open calls in cache, state and runtime directories. */
+	unsigned long otherLookups;
+	/** Candidate files tested with access(), stat(), open() or fopen(). */
+	unsigned long probes;
+	/** Lookups answered by a lookup cache. */
+	unsigned long lookupCacheHits;
+	/** Lookups on handles with a lookup cache that had to search. */
+	unsigned long lookupCacheMisses;
+	/** Memory allocations made by the library. */
+	unsigned long allocations;
+	/** Caches built by xdgInitHandle() and xdgUpdateData(). */
+	unsigned long updates;
+	/** Total time spent building those caches, in microseconds. */
+	unsigned long long updateMicroseconds;
+} xdgStats;
+
+/** Usage counters of a searchable directory, see xdgGetDirectoryStats(). */
+typedef struct /*_xdgDirectoryStats*/ {
+	/** The directory, owned by the handle. */
+	const char *directory;
+	/** Probes that found a file in the directory. */
+	unsigned long hits;
+	/** Probes that did not. */
+	unsigned long misses;
+} xdgDirectoryStats;
+
+/** Get the usage counters of all threads and handles.
+  * The counters are updated with relaxed atomics and never reset.
+  * @param stats Receives the counters.
+  * @return non-0 if successful, 0 with errno set to @c ENOSYS if the
+  * 	library was built without statistics. */
+int xdgGetStats(xdgStats *stats);
+
+/** Get hit and miss counts of the searchable directories of a handle.
+  * The counts start at zero whenever the cache is rebuilt.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @param dirClass Class of the directories.
+  * @param stats Receives up to count entries, in search order.
+  * @param count Number of entries stats can hold.
+  * @return The number of searchable directories, or 0 with errno set to
+  * 	@c EINVAL if dirClass is not a valid class or @c ENOSYS if the
+  * 	library was built without statistics. */
+size_t xdgGetDirectoryStats(xdgHandle *handle, xdgDirectoryClass dirClass, xdgDirectoryStats *stats, size_t count);
+
+/** Forget all cached lookup results and directory listings of a handle.
+  * Use this after changing files in the searched directories if the
+  * handle was initialized with @c XDG_HANDLE_LOOKUP_CACHE or
+  * @c XDG_HANDLE_LISTINGS. */
+void xdgFlushLookupCache(xdgHandle *handle);
+
+/** Limit how long lookup results and directory listings are cached.
+  * Only meaningful for handles initialized with @c XDG_HANDLE_LOOKUP_CACHE
+  * or @c XDG_HANDLE_LISTINGS. Results cached so far are flushed.
+  * @param handle Handle to data cache, initialized with xdgInitHandleEx().
+  * @param milliseconds Lifetime of cached results, or 0 to keep them until
+  * 	the cache is flushed (the default). */
+void xdgSetLookupCacheTTL(xdgHandle *handle, unsigned int milliseconds);
+
+/** Get the file descriptor signalling changes to watched directories.
+  * The descriptor becomes readable when a directory watched for a handle
+  * initialized with @c XDG_HANDLE_WATCH changed; call xdgProcessEvents()
+  * then. It is suitable for poll(2), select(2) and epoll(7) and is owned
+  * by the handle.
+  * @param handle Handle to data cache, initialized with xdgInitHandleEx().
+  * @return The file descriptor, or -1 if the handle does not watch directories. */
+int xdgEventFd(xdgHandle *handle);
+
+/** Process pending directory change notifications.
+  * If any watched directory changed, all cached lookup results are
+  * flushed. Does not block.
+  * @param handle Handle to data cache, initialized with xdgInitHandleEx().
+  * @return The number of notifications processed, or -1 if reading them
+  * 	failed (in which case errno will be set appropriately). */
+int xdgProcessEvents(xdgHandle *handle);
+
+/** Write the lookup results of a handle to its index file.
+  * Results depending on directories changed in the last few seconds are
+  * left out, as later changes to them might go unnoticed.
+  * @param handle Handle to data cache, initialized with @c XDG_HANDLE_INDEX.
+  * @return non-0 if successful or there were no new results, 0 if writing
+  * 	the index failed (in which case errno will be set appropriately).
+  * 	errno is @c EINVAL if the handle has no index and @c ENOSYS if
+  * 	the library was built without index support. */
+int xdgSaveIndex(xdgHandle *handle);
+
 /*@}*/
 /** @name Basic XDG Base Directory Queries */
 /*@{*/
 
+/** Home directory of a class of base directories.
+  * The same as xdgDataHome(), xdgConfigHome(), xdgCacheHome(),
+  * xdgStateHome() or xdgRuntimeDirectory().
+  * @param dirClass Class of the directory.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return a path as described by the standards, or NULL if no runtime
+  * 	directory has been set or dirClass is invalid (in which case
+  * 	errno is set to @c EINVAL). */
+const char * xdgHome(xdgDirectoryClass dirClass, xdgHandle *handle);
+
+/** Preference-ordered set of base directories of a class to search.
+  * The same as xdgSearchableDataDirectories() or
+  * xdgSearchableConfigDirectories(). Other classes only have their home
+  * directory, and the list of an unset runtime directory is empty.
+  * @param dirClass Class of the directories.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return A null-terminated list of directory strings, or NULL if
+  * 	dirClass is invalid. */
+const char * const * xdgSearchableDirectories(xdgDirectoryClass dirClass, xdgHandle *handle);
+
 /** Base directory for user specific data files.
   * @param handle Handle to data cache, initialized with xdgInitHandle().
   * @return a path as described by the standards. */
@@ -124,6 +412,13 @@ const char * const * xdgSearchableConfigDirectories(xdgHandle *handle);
   * @return a path as described by the standards. */
 const char * xdgCacheHome(xdgHandle *handle);
 
+/** Base directory for user specific state files, such as history and
+  * logs, that should persist but are not important enough for the data
+  * home.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return a path as described by the standards. */
+const char * xdgStateHome(xdgHandle *handle);
+
 /** Base directory for user specific non-essential runtime files such as
   * sockets and named pipes.
   * @param handle Handle to data cache, initialized with xdgInitHandle().
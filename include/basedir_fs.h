@@ -39,8 +39,26 @@ extern "C" {
 /** @name Filesystem-related XDG Base Directory Queries */
 /*@{*/
 
+/** Flags selecting how xdgDataFindEx() and xdgConfigFindEx() test
+  * whether a candidate file exists. */
+enum
+{
+	/** Accept files the process may read, as checked by access(2). This
+	  * is the mode used by xdgDataFind() and xdgConfigFind(). */
+	XDG_FIND_READABLE = 0,
+	/** Accept any existing file, regardless of permissions. */
+	XDG_FIND_EXISTS = 1 << 0,
+	/** Only accept regular files (after following symbolic links). */
+	XDG_FIND_REGULAR = 1 << 1,
+	/** Test candidates by actually opening them with fopen(), as earlier
+	  * versions of this library did. */
+	XDG_FIND_FOPEN = 1 << 2,
+	/** Stop searching at the first match, see also xdgDataFindFirst(). */
+	XDG_FIND_FIRST = 1 << 3
+};
+
 /** Find all existing data files corresponding to relativePath.
-  * Consider as performing @code fopen(filename, "r") @endcode on every possible @c filename
+  * Consider as checking every possible @c filename for readability
   * 	and returning the successful <tt>filename</tt>s.
   * @param relativePath Path to scan for.
   * @param handle Handle to data cache, initialized with xdgInitHandle().
@@ -50,7 +68,7 @@ extern "C" {
 char * xdgDataFind(const char* relativePath, xdgHandle *handle);
 
 /** Find all existing config files corresponding to relativePath.
-  * Consider as performing @code fopen(filename, "r") @endcode on every possible @c filename
+  * Consider as checking every possible @c filename for readability
   * 	and returning the successful <tt>filename</tt>s.
   * @param relativePath Path to scan for.
   * @param handle Handle to data cache, initialized with xdgInitHandle().
@@ -59,6 +77,262 @@ char * xdgDataFind(const char* relativePath, xdgHandle *handle);
   */
 char * xdgConfigFind(const char* relativePath, xdgHandle *handle);
 
+/** Find all existing data files corresponding to relativePath.
+  * Like xdgDataFind(), but with a choice of how candidates are tested.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return A sequence of null-terminated strings terminated by a double-null (empty string)
+  * 	and allocated using malloc().
+  */
+char * xdgDataFindEx(const char* relativePath, int flags, xdgHandle *handle);
+
+/** Find all existing config files corresponding to relativePath.
+  * Like xdgConfigFind(), but with a choice of how candidates are tested.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return A sequence of null-terminated strings terminated by a double-null (empty string)
+  * 	and allocated using malloc().
+  */
+char * xdgConfigFindEx(const char* relativePath, int flags, xdgHandle *handle);
+
+/** Find all existing files of a directory class corresponding to relativePath.
+  * The same as xdgDataFindEx() or xdgConfigFindEx() for those classes,
+  * and searching the home directory for the others.
+  * @param dirClass Class of the directories to search.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return A sequence of null-terminated strings terminated by a double-null (empty string)
+  * 	and allocated using malloc(), or NULL if an error occurred (in which
+  * 	case errno will be set appropriately).
+  */
+char * xdgFind(xdgDirectoryClass dirClass, const char* relativePath, int flags, xdgHandle *handle);
+
+/** Find all existing data files corresponding to relativePath without allocating memory.
+  * Like xdgDataFindEx(), but the result is written into a buffer supplied
+  * by the caller. Together with a handle and a big enough buffer no
+  * memory is allocated unless a candidate path exceeds @c PATH_MAX.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param buffer Buffer receiving a sequence of null-terminated strings
+  * 	terminated by a double-null (empty string).
+  * @param size Size of buffer.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return The size of the complete result, or 0 on error. If this is
+  * 	larger than size the contents of buffer are unspecified and the
+  * 	call may be repeated with a bigger buffer.
+  */
+size_t xdgDataFindInto(const char* relativePath, int flags, char *buffer, size_t size, xdgHandle *handle);
+
+/** Find all existing config files corresponding to relativePath without allocating memory.
+  * Like xdgDataFindInto(), but searching the config directories.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param buffer Buffer receiving the result.
+  * @param size Size of buffer.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return The size of the complete result, or 0 on error.
+  */
+size_t xdgConfigFindInto(const char* relativePath, int flags, char *buffer, size_t size, xdgHandle *handle);
+
+/** Find the first existing data file corresponding to relativePath.
+  * Like xdgDataFindEx(), but directories following the first match are
+  * not searched.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return The path of the file allocated using malloc(), or NULL with
+  * 	errno set to @c ENOENT if there is none.
+  */
+char * xdgDataFindFirst(const char* relativePath, int flags, xdgHandle *handle);
+
+/** Find the first existing config file corresponding to relativePath.
+  * Like xdgConfigFindEx(), but directories following the first match
+  * are not searched.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return The path of the file allocated using malloc(), or NULL with
+  * 	errno set to @c ENOENT if there is none.
+  */
+char * xdgConfigFindFirst(const char* relativePath, int flags, xdgHandle *handle);
+
+/** Find all existing data files corresponding to each of several relative paths.
+  * Gives the same results as calling xdgDataFindEx() for every path, but
+  * visits each searchable directory only once. The lookup cache of the
+  * handle is neither used nor filled.
+  * @param relativePaths Paths to scan for.
+  * @param count Number of items in relativePaths.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return An array of count results, each in the format returned by
+  * 	xdgDataFindEx(). The array and all results are allocated as one
+  * 	block, to be released with a single free().
+  */
+char ** xdgDataFindMany(const char * const * relativePaths, size_t count, int flags, xdgHandle *handle);
+
+/** Find all existing config files corresponding to each of several relative paths.
+  * Like xdgDataFindMany(), but searching the config directories.
+  * @param relativePaths Paths to scan for.
+  * @param count Number of items in relativePaths.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return An array of count results, each in the format returned by
+  * 	xdgConfigFindEx(), allocated as one block.
+  */
+char ** xdgConfigFindMany(const char * const * relativePaths, size_t count, int flags, xdgHandle *handle);
+
+/** A file found by xdgFindFiles() and its metadata, as given by stat(2). */
+typedef struct /*_xdgFoundFile*/ {
+	/** Path of the file, or NULL for the entry terminating a list. */
+	const char *path;
+	unsigned long long device;
+	unsigned long long inode;
+	unsigned long long size;
+	/** Modification time. */
+	long long seconds;
+	long nanoseconds;
+} xdgFoundFile;
+
+/** Find all existing files of a directory class corresponding to relativePath, with their metadata.
+  * The files are those of xdgFind(), in the same order, so that for
+  * config files each one overrides those following it. The directories
+  * are always searched, bypassing the lookup caches of the handle, and
+  * the metadata is taken from the stat(2) that found each file. Callers merging
+  * the files can keep the list with their results, and only merge them
+  * again when xdgFilesChanged() reports a change.
+  * @param dirClass Class of the directories to search.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags. @c XDG_FIND_FIRST is ignored.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return A list terminated by an entry with a NULL path. The list and
+  * 	all paths are allocated as one block, to be released with a single
+  * 	free(). NULL with errno set if an error occurred.
+  */
+xdgFoundFile * xdgFindFiles(xdgDirectoryClass dirClass, const char* relativePath, int flags, xdgHandle *handle);
+
+/** Find all existing data files corresponding to relativePath, with their metadata.
+  * The same as xdgFindFiles() with @c XDG_DATA.
+  */
+xdgFoundFile * xdgDataFindFiles(const char* relativePath, int flags, xdgHandle *handle);
+
+/** Find all existing config files corresponding to relativePath, with their metadata.
+  * The same as xdgFindFiles() with @c XDG_CONFIG.
+  */
+xdgFoundFile * xdgConfigFindFiles(const char* relativePath, int flags, xdgHandle *handle);
+
+/** Check whether files found by xdgFindFiles() have changed.
+  * Every file is examined again with stat(2). Files created since, such
+  * as one overriding the first file of the list, are not noticed; see
+  * @c XDG_HANDLE_WATCH to be told about them.
+  * @param files List returned by xdgFindFiles().
+  * @return Non-0 if a file was removed, replaced or modified, else 0.
+  */
+int xdgFilesChanged(const xdgFoundFile *files);
+
+/** Function receiving the result of an asynchronous lookup.
+  * @param result The result in the format returned by xdgDataFindEx(),
+  * 	to be freed by the callback, or NULL if the lookup failed.
+  * @param error 0, or the errno value describing why the lookup failed.
+  * @param userData The value passed when starting the lookup.
+  */
+typedef void (*xdgFindCallback)(char *result, int error, void *userData);
+
+/** Find all existing data files corresponding to relativePath without blocking.
+  * Like xdgDataFindEx(), but the directories are probed in parallel by a
+  * small pool of library threads, so the lookup takes about as long as
+  * the slowest directory rather than the sum of all of them. The
+  * callback is called once, from one of those threads; to get back to an
+  * event loop it can, for example, write to an eventfd(2) or pipe. The
+  * searched directories are copied when the lookup starts, so the handle
+  * may be updated or wiped before the callback runs.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param callback Function receiving the result.
+  * @param userData Value passed to callback.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return non-0 if the lookup was started, else 0 with errno set (to
+  * 	@c ENOSYS if the library was built without thread support).
+  */
+int xdgDataFindAsync(const char* relativePath, int flags, xdgFindCallback callback, void *userData, xdgHandle *handle);
+
+/** Find all existing config files corresponding to relativePath without blocking.
+  * Like xdgDataFindAsync(), but searching the config directories.
+  * @param relativePath Path to scan for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param callback Function receiving the result.
+  * @param userData Value passed to callback.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return non-0 if the lookup was started, else 0 with errno set.
+  */
+int xdgConfigFindAsync(const char* relativePath, int flags, xdgFindCallback callback, void *userData, xdgHandle *handle);
+
+/** Iterator over the files in a directory of all searchable directories, see xdgDataEnumerate(). */
+typedef struct _xdgEnumeration xdgEnumeration;
+
+/** Flags for xdgDataEnumerate() and xdgConfigEnumerate(), in addition to
+  * the @c XDG_FIND_* flags. */
+enum
+{
+	/** Read all directories at once on background threads, so that an
+	  * enumeration takes about as long as reading the slowest directory.
+	  * Results and their order are the same as without this flag, except
+	  * that each directory is read in full before its first file is
+	  * reported. Ignored if the library was built without thread support.
+	  * Must not be used from an xdgFindCallback. */
+	XDG_ENUMERATE_PARALLEL = 1 << 8
+};
+
+/** Start listing the files in a subdirectory of all searchable data directories.
+  * Every directory is read once, in search order. A name is reported for
+  * the first directory holding a matching file, which shadows files of the
+  * same name in later directories. Within a directory names are reported
+  * in the order the system returns them.
+  * @param relativeDirectory Directory to list, relative to the searchable
+  * 	directories, or "" for the searchable directories themselves.
+  * @param pattern fnmatch(3) pattern names must match, such as "*.desktop",
+  * 	or NULL for all names except "." and "..".
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting which files
+  * 	match, as for xdgDataFindEx(), and @c XDG_ENUMERATE_* flags. With
+  * 	@c XDG_FIND_EXISTS listed files are only examined if their type is
+  * 	asked for and not reported by the directory. @c XDG_FIND_FIRST is
+  * 	ignored.
+  * @param handle Handle to data cache, initialized with xdgInitHandle(),
+  * 	or NULL to use the environment. The directories are copied, so the
+  * 	handle may be updated or wiped during the enumeration.
+  * @return An iterator to pass to xdgEnumerateNext() and xdgEnumerateEnd(),
+  * 	or NULL with errno set (to @c ENOSYS if the library was built without
+  * 	support for reading directories or for patterns).
+  */
+xdgEnumeration * xdgDataEnumerate(const char *relativeDirectory, const char *pattern, int flags, xdgHandle *handle);
+
+/** Start listing the files in a subdirectory of all searchable config directories.
+  * Like xdgDataEnumerate(), but reading the config directories.
+  * @param relativeDirectory Directory to list, relative to the searchable directories.
+  * @param pattern fnmatch(3) pattern names must match, or NULL.
+  * @param flags Bitwise or of @c XDG_FIND_* and @c XDG_ENUMERATE_* flags.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return An iterator, or NULL with errno set.
+  */
+xdgEnumeration * xdgConfigEnumerate(const char *relativeDirectory, const char *pattern, int flags, xdgHandle *handle);
+
+/** Get the next file of an enumeration.
+  * @param enumeration Iterator returned by xdgDataEnumerate() or xdgConfigEnumerate().
+  * @param name Receives the name of the file in the listed directory, or NULL.
+  * @return The path of the file, valid until the next call, or NULL at the
+  * 	end with errno set to 0, or NULL if an error occurred (in which case
+  * 	errno will be set appropriately). Directories that cannot be read
+  * 	are skipped.
+  */
+const char * xdgEnumerateNext(xdgEnumeration *enumeration, const char **name);
+
+/** Free an enumeration.
+  * @param enumeration Iterator returned by xdgDataEnumerate() or
+  * 	xdgConfigEnumerate(), or NULL. */
+void xdgEnumerateEnd(xdgEnumeration *enumeration);
+
 /** Open first possible data file corresponding to relativePath.
   * Consider as performing @code fopen(filename, mode) @endcode on every possible @c filename
   * 	and returning the first successful @c filename or @c NULL.
@@ -79,6 +353,93 @@ FILE * xdgDataOpen(const char* relativePath, const char* mode, xdgHandle *handle
   */
 FILE * xdgConfigOpen(const char* relativePath, const char* mode, xdgHandle *handle);
 
+/** Open first possible file of a directory class corresponding to relativePath.
+  * The same as xdgDataOpen() or xdgConfigOpen() for those classes, and
+  * opening the file in the home directory for the others.
+  * @param dirClass Class of the directories to search.
+  * @param relativePath Path to scan for.
+  * @param mode Mode with which to attempt to open files (see fopen modes).
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return File pointer if successful else @c NULL. Client must use @c fclose to close file.
+  */
+FILE * xdgOpen(xdgDirectoryClass dirClass, const char* relativePath, const char* mode, xdgHandle *handle);
+
+/** Read-only view of the contents of a file, see xdgMap(). */
+typedef struct /*_xdgMapping*/ {
+	/** Contents of the file. They are not null-terminated and must not be modified. */
+	const char *data;
+	/** Size of the contents in bytes. */
+	size_t size;
+	/** Reserved for internal use, do not modify. */
+	void *reserved;
+} xdgMapping;
+
+/** Map the first possible file of a directory class corresponding to relativePath.
+  * The file is found like with xdgOpen(), and is mapped into memory
+  * with mmap(2) where available. Small files are read into memory
+  * instead, which is cheaper than mapping a page. As with any mapping,
+  * a file truncated while it is mapped may crash the process on access.
+  * @param dirClass Class of the directories to search.
+  * @param relativePath Path to scan for.
+  * @param mapping Receives the contents, to be released with xdgUnmap().
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return Non-0 if successful, 0 with errno set if no file could be
+  * 	mapped, such as to @c ENOENT if none was found.
+  */
+int xdgMap(xdgDirectoryClass dirClass, const char* relativePath, xdgMapping *mapping, xdgHandle *handle);
+
+/** Map the first possible data file corresponding to relativePath.
+  * The same as xdgMap() with @c XDG_DATA.
+  */
+int xdgDataMap(const char* relativePath, xdgMapping *mapping, xdgHandle *handle);
+
+/** Map the first possible config file corresponding to relativePath.
+  * The same as xdgMap() with @c XDG_CONFIG.
+  */
+int xdgConfigMap(const char* relativePath, xdgMapping *mapping, xdgHandle *handle);
+
+/** Release the contents of a file mapped with xdgMap().
+  * @param mapping Mapping filled in by a successful call of xdgMap().
+  */
+void xdgUnmap(xdgMapping *mapping);
+
+/** Contents of a file loaded by xdgLoadMany(). */
+typedef struct /*_xdgLoadedFile*/ {
+	/** Contents of the file followed by a null byte, or NULL if it could not be loaded. */
+	const char *data;
+	/** Size of the contents in bytes, excluding the null byte. */
+	size_t size;
+	/** 0 if the file was loaded, else an errno value such as @c ENOENT. */
+	int error;
+} xdgLoadedFile;
+
+/** Load the contents of the files of a directory class corresponding to several relative paths.
+  * The first file found for each path, as with xdgOpen(), is read into
+  * memory. Files are opened in groups, and the kernel is asked to read
+  * ahead all files of a group before the first is read, so that their
+  * I/O overlaps.
+  * @param dirClass Class of the directories to search.
+  * @param relativePaths Paths to scan for.
+  * @param count Number of items in relativePaths.
+  * @param handle Handle to data cache, initialized with xdgInitHandle().
+  * @return An array of count results in the order of relativePaths.
+  * 	The array and all contents are allocated as one block, to be
+  * 	released with a single free(). NULL with errno set if out of
+  * 	memory, in which case no file is reported.
+  */
+xdgLoadedFile * xdgLoadMany(xdgDirectoryClass dirClass, const char * const * relativePaths, size_t count,
+	xdgHandle *handle);
+
+/** Load the contents of the data files corresponding to several relative paths.
+  * The same as xdgLoadMany() with @c XDG_DATA.
+  */
+xdgLoadedFile * xdgDataLoadMany(const char * const * relativePaths, size_t count, xdgHandle *handle);
+
+/** Load the contents of the config files corresponding to several relative paths.
+  * The same as xdgLoadMany() with @c XDG_CONFIG.
+  */
+xdgLoadedFile * xdgConfigLoadMany(const char * const * relativePaths, size_t count, xdgHandle *handle);
+
 /** Create path by recursively creating directories.
   * This utility function is not part of the XDG specification, but
   * nevertheless useful in context of directory manipulation.
@@ -91,6 +452,46 @@ FILE * xdgConfigOpen(const char* relativePath, const char* mode, xdgHandle *hand
   */
 int xdgMakePath(const char * path, mode_t mode);
 
+/** Create a path below the data home directory by recursively creating directories.
+  * Like xdgMakePath() applied to relativePath appended to xdgDataHome(),
+  * which is created as well if it is missing. Handles initialized with
+  * @c XDG_HANDLE_DIRFDS create the directories relative to the descriptor
+  * of the home directory.
+  * @param relativePath The path to be created, relative to the home directory.
+  * @param mode The permissions to use for created directories, see xdgMakePath().
+  * @param handle Handle to data cache, initialized with xdgInitHandle(), or NULL.
+  * @return Zero on success, -1 if an error occured (in which case errno will
+  * 	be set appropriately)
+  */
+int xdgDataMakePath(const char * relativePath, mode_t mode, xdgHandle *handle);
+
+/** Create a path below the config home directory by recursively creating directories.
+  * Like xdgDataMakePath(), but below xdgConfigHome().
+  * @param relativePath The path to be created, relative to the home directory.
+  * @param mode The permissions to use for created directories.
+  * @param handle Handle to data cache, initialized with xdgInitHandle(), or NULL.
+  * @return Zero on success, -1 if an error occured.
+  */
+int xdgConfigMakePath(const char * relativePath, mode_t mode, xdgHandle *handle);
+
+/** Create a path below the cache home directory by recursively creating directories.
+  * Like xdgDataMakePath(), but below xdgCacheHome().
+  * @param relativePath The path to be created, relative to the home directory.
+  * @param mode The permissions to use for created directories.
+  * @param handle Handle to data cache, initialized with xdgInitHandle(), or NULL.
+  * @return Zero on success, -1 if an error occured.
+  */
+int xdgCacheMakePath(const char * relativePath, mode_t mode, xdgHandle *handle);
+
+/** Create a path below the state home directory by recursively creating directories.
+  * Like xdgDataMakePath(), but below xdgStateHome().
+  * @param relativePath The path to be created, relative to the home directory.
+  * @param mode The permissions to use for created directories.
+  * @param handle Handle to data cache, initialized with xdgInitHandle(), or NULL.
+  * @return Zero on success, -1 if an error occured.
+  */
+int xdgStateMakePath(const char * relativePath, mode_t mode, xdgHandle *handle);
+
 /*@}*/
 
 #ifdef __cplusplus
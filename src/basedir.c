@@ -43,7 +43,46 @@
 #endif
 
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
 #include <sys/stat.h>
+#if HAVE_UNISTD_H || !defined(HAVE_CONFIG_H)
+#  include <unistd.h>
+#endif
+#if HAVE_FCNTL_H || !defined(HAVE_CONFIG_H)
+#  include <fcntl.h>
+#endif
+#if HAVE_SYS_INOTIFY_H
+#  include <sys/inotify.h>
+#endif
+#if HAVE_SCHED_H
+#  include <sched.h>
+#endif
+#if HAVE_PTHREAD_H || !defined(HAVE_CONFIG_H)
+#  include <pthread.h>
+#  define XDG_HAVE_PTHREAD
+#endif
+#if HAVE_SYS_SDT_H
+#  include <sys/sdt.h>
+#endif
+#if HAVE_DIRENT_H || !defined(HAVE_CONFIG_H)
+#  include <dirent.h>
+#  define XDG_HAVE_LISTINGS
+#endif
+#if HAVE_FNMATCH_H || !defined(HAVE_CONFIG_H)
+#  include <fnmatch.h>
+#  define XDG_HAVE_FNMATCH
+#endif
+#if HAVE_SYS_MMAN_H || !defined(HAVE_CONFIG_H)
+#  include <sys/mman.h>
+#  define XDG_HAVE_MMAP
+#endif
+#if (defined(XDG_HAVE_MMAP) && HAVE_MKSTEMP) || !defined(HAVE_CONFIG_H)
+#  define XDG_HAVE_INDEX
+#endif
+#if defined(XDG_HAVE_PTHREAD) && defined(XDG_HAVE_LISTINGS)
+#  define XDG_HAVE_PARALLEL_LISTINGS
+#endif
 
 #ifdef FALSE
 #undef FALSE
@@ -88,47 +127,584 @@ static void xdgZeroMemory(void* p, int n)
 #define MAX(a, b) ((b) > (a) ? (b) : (a))
 #endif
 
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#if HAVE_ATOMIC_BUILTINS || (!defined(HAVE_CONFIG_H) && defined(__ATOMIC_SEQ_CST))
+#  define XDG_HAVE_ATOMICS
+#endif
+
+#ifdef ENABLE_STATS
+#  ifdef XDG_HAVE_ATOMICS
+#    define xdgCount(counter, n) ((void)__atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED))
+#    define xdgLoadCount(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#  else
+#    define xdgCount(counter, n) ((void)((counter) += (n)))
+#    define xdgLoadCount(counter) (counter)
+#  endif
+/** Process-wide counters, see xdgGetStats(). */
+static xdgStats xdgStatistics;
+#else
+#  define xdgCount(counter, n) ((void)0)
+#endif
+
+/** Count lookups in the directories of a class. */
+#define xdgCountLookups(dirClass, n) xdgCount(*((int)(dirClass) == XDG_CLASS_DATA ? &xdgStatistics.dataLookups : \
+	(int)(dirClass) == XDG_CLASS_CONFIG ? &xdgStatistics.configLookups : &xdgStatistics.otherLookups), n)
+
+#define xdgMalloc(size) (xdgCount(xdgStatistics.allocations, 1), malloc(size))
+#define xdgCalloc(count, size) (xdgCount(xdgStatistics.allocations, 1), calloc(count, size))
+#define xdgRealloc(ptr, size) (xdgCount(xdgStatistics.allocations, 1), realloc(ptr, size))
+#define xdgStrdup(string) (xdgCount(xdgStatistics.allocations, 1), strdup(string))
+
+/* Static tracepoints of provider xdg_basedir, for systemtap, bpftrace etc.:
+ *   find__entry(relativePath, flags), find__return(relativePath, resultSize)
+ *   open__entry(relativePath, mode), open__return(relativePath, file)
+ *   probe(relativePath, index, directory, found) for each directory tested
+ *   makepath__entry(path, mode), makepath__return(path, result)
+ *   update__entry(handle), update__return(handle, success)
+ * They are no-ops unless a tracer is attached. */
+#if HAVE_SYS_SDT_H
+#  define xdgTrace1(name, a) DTRACE_PROBE1(xdg_basedir, name, a)
+#  define xdgTrace2(name, a, b) DTRACE_PROBE2(xdg_basedir, name, a, b)
+#  define xdgTrace4(name, a, b, c, d) DTRACE_PROBE4(xdg_basedir, name, a, b, c, d)
+#else
+/* the arguments are only referenced, so that they do not count as unused */
+#  define xdgTrace1(name, a) ((void)(a))
+#  define xdgTrace2(name, a, b) ((void)(a), (void)(b))
+#  define xdgTrace4(name, a, b, c, d) ((void)(a), (void)(b), (void)(c), (void)(d))
+#endif
+
+#if HAVE_SCHED_YIELD
+#  define xdgYield() sched_yield()
+#else
+#  define xdgYield() ((void)0)
+#endif
+
+#if HAVE_MKDIRAT || !defined(HAVE_CONFIG_H)
+#  define XDG_HAVE_MKDIRAT
+#endif
+
+#if (HAVE_OPENAT && HAVE_FSTATAT && HAVE_FACCESSAT) || !defined(HAVE_CONFIG_H)
+#  define XDG_HAVE_DIRFDS
+#  ifdef O_PATH
+#    define XDG_DIRFD_OPEN_FLAGS (O_PATH | O_DIRECTORY | O_CLOEXEC)
+#  else
+#    define XDG_DIRFD_OPEN_FLAGS (O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+#  endif
+#endif
+
 static const char
 	DefaultRelativeDataHome[] = DIR_SEPARATOR_STR ".local" DIR_SEPARATOR_STR "share",
 	DefaultRelativeConfigHome[] = DIR_SEPARATOR_STR ".config",
 	DefaultDataDirectories1[] = DIR_SEPARATOR_STR "usr" DIR_SEPARATOR_STR "local" DIR_SEPARATOR_STR "share",
 	DefaultDataDirectories2[] = DIR_SEPARATOR_STR "usr" DIR_SEPARATOR_STR "share",
 	DefaultConfigDirectories[] = DIR_SEPARATOR_STR "etc" DIR_SEPARATOR_STR "xdg",
-	DefaultRelativeCacheHome[] = DIR_SEPARATOR_STR ".cache";
+	DefaultRelativeCacheHome[] = DIR_SEPARATOR_STR ".cache",
+	DefaultRelativeStateHome[] = DIR_SEPARATOR_STR ".local" DIR_SEPARATOR_STR "state";
 
 static const char
 	*DefaultDataDirectoriesList[] = { DefaultDataDirectories1, DefaultDataDirectories2, NULL },
-	*DefaultConfigDirectoriesList[] = { DefaultConfigDirectories, NULL };
+	*DefaultConfigDirectoriesList[] = { DefaultConfigDirectories, NULL },
+	*NoDirectoriesList[] = { NULL };
+
+/** Directory classes, numbered like xdgDirectoryClass. */
+enum
+{
+	XDG_CLASS_DATA = XDG_DATA,
+	XDG_CLASS_CONFIG = XDG_CONFIG,
+	XDG_CLASS_CACHE = XDG_CACHE,
+	XDG_CLASS_STATE = XDG_STATE,
+	XDG_CLASS_RUNTIME = XDG_RUNTIME,
+	XDG_CLASS_COUNT
+};
 
+/** Number of bits a directory class takes in lookup cache keys. */
+#define XDG_CLASS_BITS 3
+
+/** Where the directories of a class come from. */
+typedef struct _xdgClassInfo
+{
+	/** Variable holding the home directory. */
+	const char * homeVariable;
+	/** Default home directory relative to $HOME, or NULL if there is none. */
+	const char * relativeHome;
+	/** Variable holding further directories to search, or NULL. */
+	const char * directoriesVariable;
+	/** Directories searched if that variable is unset or empty. */
+	const char ** defaults;
+} xdgClassInfo;
+
+/** Variable holding the runtime directory for callers without a handle.
+ * Handles read $XDG_RUNTIME_DIR, but this has always been looked up as
+ * well and programs may depend on it. */
+static const char xdgNullRuntimeVariable[] = "XDG_RUNTIME_DIRECTORY";
+
+/** Directory classes by @c XDG_CLASS_* constant. */
+static const xdgClassInfo xdgClasses[XDG_CLASS_COUNT] =
+{
+	{ "XDG_DATA_HOME", DefaultRelativeDataHome, "XDG_DATA_DIRS", DefaultDataDirectoriesList },
+	{ "XDG_CONFIG_HOME", DefaultRelativeConfigHome, "XDG_CONFIG_DIRS", DefaultConfigDirectoriesList },
+	{ "XDG_CACHE_HOME", DefaultRelativeCacheHome, NULL, NoDirectoriesList },
+	{ "XDG_STATE_HOME", DefaultRelativeStateHome, NULL, NoDirectoriesList },
+	{ "XDG_RUNTIME_DIR", NULL, NULL, NoDirectoriesList }
+};
+
+/** Data cache built from the environment.
+ * The cache is allocated as a single block of memory containing this
+ * structure followed by all lists and strings it points to, see
+ * xdgNewCache(). Caches of cloned handles may instead point to the
+ * lists of the cache they were cloned from. Caches are reference
+ * counted and never modified, see xdgFreeCache().
+ */
 typedef struct _xdgCachedData
 {
-	char * dataHome;
-	char * configHome;
-	char * cacheHome;
-	char * runtimeDirectory;
-	/* Note: string lists are null-terminated and all items */
-	/* except the first are assumed to be allocated using malloc. */
-	/* The first item is assumed to be allocated by malloc only if */
-	/* it is not equal to the appropriate home directory string above. */
-	char ** searchableDataDirectories;
-	char ** searchableConfigDirectories; 
+	/* Note: all arrays are indexed by @c XDG_CLASS_* constants. */
+	/** Home directories, NULL for an unset runtime directory. */
+	char * homes[XDG_CLASS_COUNT];
+	/* Note: string lists are null-terminated and their first item */
+	/* is the home directory of the class, unless that is NULL. */
+	char ** searchable[XDG_CLASS_COUNT];
+	/* Note: file descriptor lists are either NULL or parallel to the */
+	/* directory lists above. An entry is -1 if the directory could */
+	/* not be opened, in which case it is searched by path. */
+	int * searchableFds[XDG_CLASS_COUNT];
+	/* Note: hit and miss counts per directory are either NULL or hold */
+	/* two entries for each item of the directory lists above. */
+	unsigned long * searchableCounts[XDG_CLASS_COUNT];
+	/* Note: length lists are parallel to the directory lists above and */
+	/* exclude trailing separators, see xdgDirectoryLength(). */
+	size_t * searchableLengths[XDG_CLASS_COUNT];
+	/** Number of handles and caches using the cache. */
+	unsigned long refs;
+	/** Cache owning the lists of the classes in xdgCachedData::shared, or NULL. */
+	struct _xdgCachedData * parent;
+	/** Bitwise or of <tt>1 << XDG_CLASS_*</tt> for the classes of the parent. */
+	unsigned int shared;
+	/** Whether directories holds the values the cache was built from, see xdgIsSameSource(). */
+	int recorded;
+	/** Unsplit directory lists the cache was built from, or NULL for defaults. */
+	char * directories[XDG_CLASS_COUNT];
 } xdgCachedData;
 
+/** Whether the lists of a class are shared with a parent cache. */
+#define xdgIsShared(shared, dirClass) ((shared) & (1u << (dirClass)))
+
+/** Number of buckets a lookup cache starts with. */
+#define XDG_LOOKUP_CACHE_MIN_BUCKETS 64
+/** A lookup cache with more entries than this is flushed rather than grown. */
+#define XDG_LOOKUP_CACHE_MAX_ENTRIES 4096
+
+/** Cached result of a find query. */
+typedef struct _xdgLookupEntry
+{
+	struct _xdgLookupEntry * next;
+	unsigned int hash;
+	/** Directory class and probe flags, see xdgLookupKind(). */
+	int kind;
+	/** Time in milliseconds after which the entry is stale, or 0 if it never is. */
+	unsigned long long expires;
+	/** Length of the result including the terminating double-null. */
+	size_t resultLength;
+	/** The relative path followed by the result. */
+	char data[];
+} xdgLookupEntry;
+
+/** Hash table of find query results, including empty ones. */
+typedef struct _xdgLookupCache
+{
+	xdgLookupEntry ** buckets;
+	unsigned int bucketCount;
+	unsigned int entryCount;
+	/** Lifetime of new entries in milliseconds, 0 if unlimited. */
+	unsigned int ttl;
+} xdgLookupCache;
+
+/** Number of hash buckets of a watch set. */
+#define XDG_WATCH_BUCKETS 256
+
+/** Directory watched for lookups, see xdgWatchPath(). */
+typedef struct _xdgWatch
+{
+	struct _xdgWatch * next;
+	unsigned int hash;
+	/** inotify watch descriptor, or -1 if the directory could not be watched. */
+	int wd;
+	char path[];
+} xdgWatch;
+
+/** Hash table of the directories a handle watches, so that each is added only once. */
+typedef struct _xdgWatchSet
+{
+	/** @c XDG_WATCH_BUCKETS buckets, allocated when the first watch is added. */
+	xdgWatch ** buckets;
+	unsigned int entryCount;
+} xdgWatchSet;
+
+/** A listing cache with more entries than this is flushed rather than grown. */
+#define XDG_LISTING_CACHE_MAX_ENTRIES 256
+/** Number of hash buckets of a listing cache. */
+#define XDG_LISTING_CACHE_BUCKETS 64
+/** Lookups in more searchable directories than this do not use listings. */
+#define XDG_LISTING_MAX_DIRS 64
+
+/** Result of reading a directory for a listing. */
+enum
+{
+	XDG_LISTING_READ,
+	/** The directory does not exist, so neither does anything in it. */
+	XDG_LISTING_MISSING,
+	/** The directory could not be read, lookups in it must probe. */
+	XDG_LISTING_UNREADABLE
+};
+
+/** Names in a subdirectory of a searchable directory.
+  * The listing is allocated as a single block of memory holding this
+  * structure followed by the hash set, the entries and the subdirectory.
+  */
+typedef struct _xdgListing
+{
+	struct _xdgListing * next;
+	unsigned int hash;
+	int dirClass;
+	/** Index of the searchable directory in its list. */
+	unsigned int dirIndex;
+	/** @c XDG_LISTING_* constant. */
+	int status;
+	/** Time in milliseconds after which the listing is stale, or 0 if it never is. */
+	unsigned long long expires;
+	/** Number of slots in the hash set, a power of two. */
+	unsigned int slotCount;
+	/** Hash set of names, a slot is 0 or the offset of a name in entries. */
+	unsigned int * slots;
+	/** Entries made of an @c XDG_ENTRY_* byte followed by a null-terminated name. */
+	char * entries;
+	/** The subdirectory relative to the searchable directory. */
+	char * subdirectory;
+} xdgListing;
+
+/** Type of a listed name as far as the directory reports it. */
+enum
+{
+	/** A symbolic link, or the type is not reported. */
+	XDG_ENTRY_UNKNOWN,
+	XDG_ENTRY_REGULAR,
+	/** Anything that is neither a regular file nor a symbolic link. */
+	XDG_ENTRY_OTHER
+};
+
+/** What is known about a lookup in a directory without probing it. */
+enum
+{
+	XDG_HINT_PROBE,
+	XDG_HINT_ABSENT,
+	XDG_HINT_FOUND
+};
+
+/** Hash table of directory listings. */
+typedef struct _xdgListingCache
+{
+	/** @c XDG_LISTING_CACHE_BUCKETS buckets, or NULL until the first listing is made. */
+	xdgListing ** buckets;
+	unsigned int entryCount;
+} xdgListingCache;
+
+/* Note: an index file consists of an xdgIndexHeader followed by the */
+/* arrays of stamps, groups and entries it counts, and a string area */
+/* starting with the search lists the index was made for. All offsets */
+/* are relative to the string area and checked when the file is loaded. */
+/* Fields are in native byte order, 64 bit fields come first so that */
+/* the layout does not depend on their alignment. */
+
+/** Magic number at the start of an index file. */
+#define XDG_INDEX_MAGIC 0x49474458u
+/** Format version of index files, changed on incompatible changes. */
+#define XDG_INDEX_VERSION 2u
+/** Directories changed less than this many seconds before an index is
+  * written are not trusted, as a change within the resolution of their
+  * modification time would go unnoticed. */
+#define XDG_INDEX_SETTLE_TIME 2
+
+/** Start of an index file. */
+typedef struct _xdgIndexHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	/** Size of the whole file. */
+	unsigned int size;
+	unsigned int stampCount;
+	unsigned int groupCount;
+	unsigned int entryCount;
+	/** Size of the search lists at the start of the string area. */
+	unsigned int listsSize;
+	unsigned int stringsSize;
+} xdgIndexHeader;
+
+/** Identity of the deepest existing ancestor of a directory. Creating,
+  * removing or renaming anything in it changes its modification time. */
+typedef struct _xdgIndexStamp
+{
+	unsigned long long device;
+	unsigned long long inode;
+	unsigned long long seconds;
+	unsigned int nanoseconds;
+	/** Length of the ancestor's path, a prefix of the directory's path. */
+	unsigned int prefixLength;
+} xdgIndexStamp;
+
+/** Lookups of relative paths in the same subdirectory of a directory class. */
+typedef struct _xdgIndexGroup
+{
+	/** @c XDG_CLASS_* constant. */
+	unsigned int dirClass;
+	/** Offset of the subdirectory, empty for the searched directories themselves. */
+	unsigned int path;
+	/** Index of the first of the stamps for each searched directory. */
+	unsigned int stamps;
+} xdgIndexGroup;
+
+/** Indexed result of a find query, sorted by hash. */
+typedef struct _xdgIndexEntry
+{
+	unsigned int hash;
+	int kind;
+	unsigned int group;
+	unsigned int path;
+	unsigned int result;
+	unsigned int resultLength;
+} xdgIndexEntry;
+
+/** A memory-mapped index file. */
+typedef struct _xdgLookupIndex
+{
+	/** The mapped file, or NULL if no valid index was found. */
+	const char * map;
+	const xdgIndexStamp * stamps;
+	const xdgIndexGroup * groups;
+	const xdgIndexEntry * entries;
+	const char * strings;
+	/** Non-zero for each group whose stamps matched when last checked. */
+	unsigned char * validGroups;
+	/** Non-zero if lookups were made that are not in the file. */
+	int dirty;
+} xdgLookupIndex;
+
+/** State associated with a handle that outlives xdgUpdateData(). */
+typedef struct _xdgHandleData
+{
+	/** Current cache. Accessed atomically for @c XDG_HANDLE_CONCURRENT handles. */
+	xdgCachedData * cache;
+	/** Bitwise or of @c XDG_HANDLE_* flags the handle was initialized with. */
+	int flags;
+	xdgLookupCache lookups;
+	/** Index file backing xdgHandleData::lookups for @c XDG_HANDLE_INDEX handles. */
+	xdgLookupIndex index;
+	/** Directory listings of @c XDG_HANDLE_LISTINGS handles. */
+	xdgListingCache listings;
+	/** inotify descriptor invalidating xdgHandleData::lookups, or -1. */
+	int watchFd;
+	/** Directories watched through watchFd for the current cache. */
+	xdgWatchSet watches;
+	/* Note: readers of concurrent handles announce themselves in the */
+	/* reader count selected by the current phase, see xdgBeginRead(). */
+	/* Before freeing a replaced cache xdgUpdateData() flips the phase */
+	/* and waits for the previous count to drain, twice, so that all */
+	/* sections which could have seen the old cache have ended. */
+	unsigned int readPhase;
+	unsigned long readers[2];
+	/** Non-zero while a thread is updating a concurrent handle. */
+	int updating;
+	/** Values replacing those of the environment, in one block, or NULL. */
+	xdgHandleValues * values;
+	/** Whether values not in xdgHandleData::values come from the environment. */
+	int useEnvironment;
+} xdgHandleData;
+
+/** Get state associated with a handle */
+static xdgHandleData* xdgGetHandleData(xdgHandle *handle)
+{
+	return ((xdgHandleData*)(handle->reserved));
+}
+
 /** Get cache object associated with a handle */
 static xdgCachedData* xdgGetCache(xdgHandle *handle)
 {
-	return ((xdgCachedData*)(handle->reserved));
+#ifdef XDG_HAVE_ATOMICS
+	return __atomic_load_n(&xdgGetHandleData(handle)->cache, __ATOMIC_SEQ_CST);
+#else
+	return xdgGetHandleData(handle)->cache;
+#endif
+}
+
+int xdgBeginRead(xdgHandle *handle)
+{
+#ifdef XDG_HAVE_ATOMICS
+	xdgHandleData *data = xdgGetHandleData(handle);
+	unsigned int phase;
+	if (!(data->flags & XDG_HANDLE_CONCURRENT)) return 0;
+	phase = __atomic_load_n(&data->readPhase, __ATOMIC_SEQ_CST) & 1;
+	__atomic_fetch_add(&data->readers[phase], 1, __ATOMIC_SEQ_CST);
+	return phase;
+#else
+	return 0;
+#endif
+}
+
+void xdgEndRead(xdgHandle *handle, int ticket)
+{
+#ifdef XDG_HAVE_ATOMICS
+	xdgHandleData *data = xdgGetHandleData(handle);
+	if (data->flags & XDG_HANDLE_CONCURRENT)
+		__atomic_fetch_sub(&data->readers[ticket], 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+#ifdef XDG_HAVE_ATOMICS
+/** Wait until no read section of a concurrent handle can still see a replaced cache. */
+static void xdgSynchronizeReaders(xdgHandleData *data)
+{
+	unsigned int phase;
+	int i;
+	for (i = 0; i < 2; ++i)
+	{
+		phase = __atomic_fetch_add(&data->readPhase, 1, __ATOMIC_SEQ_CST) & 1;
+		while (__atomic_load_n(&data->readers[phase], __ATOMIC_SEQ_CST))
+			xdgYield();
+	}
 }
+#endif
+
+static void xdgFlushLookups(xdgLookupCache *lookups);
+static void xdgFlushListings(xdgListingCache *listings);
+static void xdgForgetWatches(xdgWatchSet *watches, int watchFd);
+static void xdgLoadIndex(xdgLookupIndex *index, const xdgCachedData *cache);
+static void xdgValidateIndex(xdgLookupIndex *index, const xdgCachedData *cache);
+static void xdgDropIndex(xdgLookupIndex *index);
+static int xdgWriteIndex(xdgHandleData *data, const xdgCachedData *cache);
 
 xdgHandle * xdgInitHandle(xdgHandle *handle)
 {
-	if (!handle) return 0;
-	handle->reserved = 0; /* So xdgUpdateData() doesn't free it */
+	return xdgInitHandleEx(handle, 0);
+}
+
+/** Allocate the state of a handle without a cache.
+ * Sets @c errno if the flags are invalid or a resource is unavailable.
+ * @param flags Bitwise or of @c XDG_HANDLE_* flags.
+ * @return The state, or NULL on failure.
+ */
+static xdgHandleData * xdgNewHandleData(int flags)
+{
+	xdgHandleData *data;
+	if ((flags & XDG_HANDLE_CONCURRENT) &&
+		(flags & (XDG_HANDLE_LOOKUP_CACHE | XDG_HANDLE_WATCH | XDG_HANDLE_INDEX | XDG_HANDLE_LISTINGS)))
+	{
+		/* lookup caches are modified by lookups, and so not safe to share */
+		errno = EINVAL;
+		return 0;
+	}
+#ifndef XDG_HAVE_ATOMICS
+	if (flags & XDG_HANDLE_CONCURRENT)
+	{
+		errno = ENOSYS;
+		return 0;
+	}
+#endif
+	if (!(data = (xdgHandleData*)xdgMalloc(sizeof(xdgHandleData)))) return 0;
+	xdgZeroMemory(data, sizeof(xdgHandleData));
+	data->flags = flags;
+	data->watchFd = -1;
+#if HAVE_SYS_INOTIFY_H
+	if ((flags & XDG_HANDLE_WATCH) && (data->watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+	{
+		free(data);
+		return 0;
+	}
+#endif
+	return data;
+}
+
+/** Free the state of a handle whose cache could not be built. */
+static void xdgDeleteHandleData(xdgHandleData *data)
+{
+	xdgForgetWatches(&data->watches, -1);
+	free(data->watches.buckets);
+	if (data->watchFd >= 0)
+		close(data->watchFd);
+	free(data->values);
+	free(data);
+}
+
+/** Build the first cache of a handle, see xdgInitHandleEx(). */
+static xdgHandle * xdgStartHandle(xdgHandle *handle, xdgHandleData *data)
+{
+	handle->reserved = data;
 	if (xdgUpdateData(handle))
 		return handle;
+	xdgDeleteHandleData(data);
+	handle->reserved = 0;
 	return 0;
 }
 
+xdgHandle * xdgInitHandleEx(xdgHandle *handle, int flags)
+{
+	xdgHandleData *data;
+	if (!handle || !(data = xdgNewHandleData(flags))) return 0;
+	data->useEnvironment = TRUE;
+	return xdgStartHandle(handle, data);
+}
+
+/** Number of strings in a xdgHandleValues structure. */
+#define XDG_VALUE_COUNT (sizeof(xdgHandleValues)/sizeof(const char *))
+
+/** Copy handle values into a single block of memory.
+ * @param base Values to copy, or NULL.
+ * @param overrides Values replacing those of base where not NULL, or NULL.
+ * @return The copy, to be freed with free(), or NULL if out of memory.
+ */
+static xdgHandleValues * xdgCopyValues(const xdgHandleValues *base, const xdgHandleValues *overrides)
+{
+	const char *merged[XDG_VALUE_COUNT];
+	const char **fields;
+	xdgHandleValues *copy;
+	size_t size = sizeof(xdgHandleValues), length, i;
+	char *strings;
+
+	/* the structure holds nothing but strings, so treat it as an array */
+	for (i = 0; i < XDG_VALUE_COUNT; ++i)
+	{
+		merged[i] = overrides ? ((const char * const *)overrides)[i] : NULL;
+		if (!merged[i] && base)
+			merged[i] = ((const char * const *)base)[i];
+		if (merged[i])
+			size += strlen(merged[i])+1;
+	}
+	if (!(copy = (xdgHandleValues*)xdgMalloc(size))) return NULL;
+	fields = (const char **)copy;
+	strings = (char*)(copy+1);
+	for (i = 0; i < XDG_VALUE_COUNT; ++i)
+	{
+		fields[i] = NULL;
+		if (!merged[i]) continue;
+		length = strlen(merged[i])+1;
+		fields[i] = (const char *)memcpy(strings, merged[i], length);
+		strings += length;
+	}
+	return copy;
+}
+
+xdgHandle * xdgInitHandleFromValues(xdgHandle *handle, int flags, const xdgHandleValues *values)
+{
+	xdgHandleData *data;
+	if (!handle || !(data = xdgNewHandleData(flags))) return 0;
+	if (!(data->values = xdgCopyValues(values, 0)))
+	{
+		xdgDeleteHandleData(data);
+		return 0;
+	}
+	return xdgStartHandle(handle, data);
+}
+
 /** Free all memory used by a NULL-terminated string list */
 static void xdgFreeStringList(char** list)
 {
@@ -139,136 +715,153 @@ static void xdgFreeStringList(char** list)
 	free(list);
 }
 
-/** Free all data in the cache and set pointers to null. */
-static void xdgFreeData(xdgCachedData *cache)
+/** Add a reference to a cache, see xdgFreeCache(). */
+static void xdgReferenceCache(xdgCachedData *cache)
 {
-	if (cache->dataHome);
-	{
-		/* the first element of the directory lists is usually the home directory */
-		if (cache->searchableDataDirectories && cache->searchableDataDirectories[0] != cache->dataHome)
-			free(cache->dataHome);
-		cache->dataHome = 0;
-	}
-	if (cache->configHome);
-	{
-		if (cache->searchableConfigDirectories && cache->searchableConfigDirectories[0] != cache->configHome)
-			free(cache->configHome);
-		cache->configHome = 0;
-	}
-	if (cache->cacheHome)
-	{
-		free(cache->cacheHome);
-		cache->cacheHome = 0;
-	}
-	xdgFreeStringList(cache->searchableDataDirectories);
-	cache->searchableDataDirectories = 0;
-	xdgFreeStringList(cache->searchableConfigDirectories);
-	cache->searchableConfigDirectories = 0;
+#ifdef XDG_HAVE_ATOMICS
+	__atomic_add_fetch(&cache->refs, 1, __ATOMIC_RELAXED);
+#else
+	++cache->refs;
+#endif
 }
 
-void xdgWipeHandle(xdgHandle *handle)
+/** Drop a reference to a cache.
+ * The last reference closes all file descriptors of the cache, frees
+ * it and drops its reference to its parent.
+ */
+static void xdgFreeCache(xdgCachedData *cache)
 {
-	xdgCachedData* cache = xdgGetCache(handle);
-	xdgFreeData(cache);
+	int *fd, i;
+	if (!cache) return;
+#ifdef XDG_HAVE_ATOMICS
+	if (__atomic_sub_fetch(&cache->refs, 1, __ATOMIC_ACQ_REL)) return;
+#else
+	if (--cache->refs) return;
+#endif
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+		if (cache->searchableFds[i] && !xdgIsShared(cache->shared, i))
+			for (fd = cache->searchableFds[i]; *fd != -2; ++fd)
+				if (*fd >= 0) close(*fd);
+	xdgFreeCache(cache->parent);
 	free(cache);
 }
 
-/** Split string at ':', return null-terminated list of resulting strings.
- * @param string String to be split
- */
-static char** xdgSplitPath(const char* string)
+void xdgWipeHandle(xdgHandle *handle)
 {
-	unsigned int size, i, j, k;
-	char** itemlist;
+	xdgHandleData* data = xdgGetHandleData(handle);
+	/* failing to save the index only makes the next start slower */
+	if (data->index.dirty)
+		xdgWriteIndex(data, data->cache);
+	xdgDropIndex(&data->index);
+	xdgFreeCache(data->cache);
+	xdgFlushLookups(&data->lookups);
+	free(data->lookups.buckets);
+	xdgFlushListings(&data->listings);
+	free(data->listings.buckets);
+	xdgForgetWatches(&data->watches, -1);
+	free(data->watches.buckets);
+	if (data->watchFd >= 0)
+		close(data->watchFd);
+	free(data->values);
+	free(data);
+}
 
-	/* Get the number of paths */
-	size=2; /* One item more than seperators + terminating null item */
-	for (i = 0; string[i]; ++i)
-	{
-#ifndef NO_ESCAPES_IN_PATHS
-		if (string[i] == '\\' && string[i+1])
-		{
-			/* skip escaped characters including seperators */
-			++i;
-			continue;
-		}
+/** Handle returned by xdgDefaultHandle(), never wiped. */
+static xdgHandle xdgDefault;
+/** Pointer to xdgDefault once initialized, 0 if initialization failed. */
+static xdgHandle *xdgDefaultResult;
+/** errno set by the failed initialization of xdgDefault. */
+static int xdgDefaultErrno;
+#ifdef XDG_HAVE_PTHREAD
+static pthread_once_t xdgDefaultOnce = PTHREAD_ONCE_INIT;
 #endif
-		if (string[i] == PATH_SEPARATOR_CHAR) ++size;
-	}
-	
-	if (!(itemlist = (char**)malloc(sizeof(char*)*size))) return 0;
-	xdgZeroMemory(itemlist, sizeof(char*)*size);
 
-	for (i = 0; *string; ++i)
+/** Initialize the handle returned by xdgDefaultHandle(). */
+static void xdgInitDefaultHandle(void)
+{
+	int flags = 0;
+#ifdef XDG_HAVE_ATOMICS
+	flags |= XDG_HANDLE_CONCURRENT;
+#endif
+	if (!(xdgDefaultResult = xdgInitHandleEx(&xdgDefault, flags)))
+		xdgDefaultErrno = errno;
+}
+
+xdgHandle * xdgDefaultHandle(void)
+{
+#ifdef XDG_HAVE_PTHREAD
+	pthread_once(&xdgDefaultOnce, xdgInitDefaultHandle);
+#else
+	static int initialized = FALSE;
+	if (!initialized)
 	{
-		/* get length of current string  */
-		for (j = 0; string[j] && string[j] != PATH_SEPARATOR_CHAR; ++j)
-#ifndef NO_ESCAPES_IN_PATHS
-			if (string[j] == '\\' && string[j+1]) ++j
+		xdgInitDefaultHandle();
+		initialized = TRUE;
+	}
 #endif
-			;
-	
-		if (!(itemlist[i] = (char*)malloc(j+1))) { xdgFreeStringList(itemlist); return 0; }
+	if (!xdgDefaultResult)
+		errno = xdgDefaultErrno;
+	return xdgDefaultResult;
+}
 
-		/* transfer string, unescaping any escaped seperators */
-		for (k = j = 0; string[j] && string[j] != PATH_SEPARATOR_CHAR; ++j, ++k)
-		{
-#ifndef NO_ESCAPES_IN_PATHS
-			if (string[j] == '\\' && string[j+1] == PATH_SEPARATOR_CHAR) ++j; /* replace escaped ':' with just ':' */
-			else if (string[j] == '\\' && string[j+1]) /* skip escaped characters so escaping remains aligned to pairs. */
-			{
-				itemlist[i][k]=string[j];
-				++j, ++k;
-			}
+int xdgGetStats(xdgStats *stats)
+{
+#ifdef ENABLE_STATS
+	stats->dataLookups = xdgLoadCount(xdgStatistics.dataLookups);
+	stats->configLookups = xdgLoadCount(xdgStatistics.configLookups);
+	stats->otherLookups = xdgLoadCount(xdgStatistics.otherLookups);
+	stats->probes = xdgLoadCount(xdgStatistics.probes);
+	stats->lookupCacheHits = xdgLoadCount(xdgStatistics.lookupCacheHits);
+	stats->lookupCacheMisses = xdgLoadCount(xdgStatistics.lookupCacheMisses);
+	stats->allocations = xdgLoadCount(xdgStatistics.allocations);
+	stats->updates = xdgLoadCount(xdgStatistics.updates);
+	stats->updateMicroseconds = xdgLoadCount(xdgStatistics.updateMicroseconds);
+	return TRUE;
+#else
+	xdgZeroMemory(stats, sizeof(xdgStats));
+	errno = ENOSYS;
+	return FALSE;
 #endif
-			itemlist[i][k] = string[j];
-		}
-		itemlist[i][k] = 0; /* Bugfix provided by Diego 'Flameeyes' Pettenò */
-		/* move to next string */
-		string += j;
-		if (*string == PATH_SEPARATOR_CHAR) string++; /* skip seperator */
-	}
-	return itemlist;
 }
 
-/** Get $PATH-style environment variable as list of strings.
- * If $name is unset or empty, use default strings specified by variable arguments.
- * @param name Name of environment variable
- * @param defaults NULL-terminated list of strings to be copied and used as defaults
- */
-static char** xdgGetPathListEnv(const char* name, const char ** defaults)
+/** Check that a public directory class is valid, setting errno to @c EINVAL if not. */
+static int xdgCheckClass(int dirClass)
 {
-	const char* env;
-	char* item;
-	char** itemlist;
-	int i, size;
+	if (dirClass >= 0 && dirClass < XDG_CLASS_COUNT)
+		return TRUE;
+	errno = EINVAL;
+	return FALSE;
+}
 
-	env = getenv(name);
-	if (env && env[0])
-	{
-		if (!(item = (char*)malloc(strlen(env)+1))) return NULL;
-		strcpy(item, env);
+size_t xdgGetDirectoryStats(xdgHandle *handle, xdgDirectoryClass dirClass, xdgDirectoryStats *stats, size_t count)
+{
+#ifdef ENABLE_STATS
+	xdgCachedData *cache;
+	char **dirs;
+	unsigned long *counts;
+	size_t i;
 
-		itemlist = xdgSplitPath(item);
-		free(item);
-	}
-	else
-	{
-		if (!defaults) return NULL;
-		for (size = 0; defaults[size]; ++size) ; ++size;
-		if (!(itemlist = (char**)malloc(sizeof(char*)*size))) return NULL;
-		xdgZeroMemory(itemlist, sizeof(char*)*(size));
+	if (!xdgCheckClass(dirClass)) return 0;
+	cache = xdgGetCache(handle);
+	dirs = cache->searchable[dirClass];
+	counts = cache->searchableCounts[dirClass];
 
-		/* Copy defaults into itemlist. */
-		/* Why all this funky stuff? So the result can be handled uniformly by xdgFreeStringList. */
-		for (i = 0; defaults[i]; ++i)
-		{
-			if (!(item = (char*)malloc(strlen(defaults[i])+1))) { xdgFreeStringList(itemlist); return NULL; }
-			strcpy(item, defaults[i]);
-			itemlist[i] = item;
-		}
+	for (i = 0; dirs[i]; ++i)
+	{
+		if (i >= count) continue;
+		stats[i].directory = dirs[i];
+		stats[i].hits = xdgLoadCount(counts[2*i]);
+		stats[i].misses = xdgLoadCount(counts[2*i+1]);
 	}
-	return itemlist;
+	return i;
+#else
+	(void)handle;
+	(void)dirClass;
+	(void)stats;
+	(void)count;
+	errno = ENOSYS;
+	return 0;
+#endif
 }
 
 /** Get value of an environment variable.
@@ -295,386 +888,4318 @@ static char* xdgEnvDup(const char *name)
 {
 	const char *env;
 	if ((env = xdgGetEnv(name)))
-		return strdup(env);
+		return xdgStrdup(env);
 	else
 		return NULL;
 }
 
-/** Update all *Home variables of cache.
- * This includes xdgCachedData::dataHome, xdgCachedData::configHome and xdgCachedData::cacheHome.
- * @param cache Data cache to be updated
+/** Values a data cache is built from.
+ * They are gathered before the cache is allocated so its size can be
+ * computed in advance. Home directories are the concatenation of a
+ * base and a suffix. All arrays are indexed by @c XDG_CLASS_* constants.
  */
-static int xdgUpdateHomeDirectories(xdgCachedData* cache)
-{
-	const char *homeenv;
-	char *value;
-	unsigned int homelen;
-	static const unsigned int extralen =
-		MAX(MAX(sizeof(DefaultRelativeDataHome),
-					sizeof(DefaultRelativeConfigHome)),
-				sizeof(DefaultRelativeCacheHome));
-
-	if (!(cache->dataHome = xdgEnvDup("XDG_DATA_HOME")) && errno == ENOMEM) return FALSE;
-	if (!(cache->configHome = xdgEnvDup("XDG_CONFIG_HOME")) && errno == ENOMEM) return FALSE;
-	if (!(cache->cacheHome = xdgEnvDup("XDG_CACHE_HOME")) && errno == ENOMEM) return FALSE;
-	if (!(cache->runtimeDirectory = xdgEnvDup("XDG_RUNTIME_DIR")) && errno == ENOMEM) return FALSE;
-	errno = 0;
-
-	if (cache->dataHome && cache->configHome && cache->cacheHome) return TRUE;
-
-	if (!(homeenv = xdgGetEnv("HOME")))
-		return FALSE;
+typedef struct _xdgCacheSource
+{
+	/** Base of the home directories, NULL for an unset runtime directory. */
+	const char * homes[XDG_CLASS_COUNT];
+	const char * homeSuffixes[XDG_CLASS_COUNT];
+	/** $XDG_DATA_DIRS and the like, or NULL if lists are used. */
+	const char * directories[XDG_CLASS_COUNT];
+	/** Directories used instead of unset directories, usually the defaults. */
+	const char ** lists[XDG_CLASS_COUNT];
+	/** Cache to share the lists of the classes in shared with, or NULL. */
+	xdgCachedData * parent;
+	/** Bitwise or of <tt>1 << XDG_CLASS_*</tt>, see xdgIsShared(). */
+	unsigned int shared;
+} xdgCacheSource;
 
-	/* Allocate maximum needed for any of the 3 default values */
-	if (!(value = (char*)malloc((homelen = strlen(homeenv))+extralen))) return FALSE;
-	memcpy(value, homeenv, homelen+1);
+/** Gather the values for a data cache from the environment.
+ * Sets @c errno to @c EINVAL if a default home directory is needed and @c \$HOME is not set.
+ * @param source Structure receiving the values. They point into the
+ * 	environment and values.
+ * @param values Values replacing those of the environment, or NULL.
+ * 	If values has a user home, the home variables of the environment
+ * 	are not used.
+ * @param useEnvironment FALSE to use only values and the defaults.
+ */
+static int xdgGetCacheSource(xdgCacheSource *source, const xdgHandleValues *values, int useEnvironment)
+{
+	const xdgClassInfo *info;
+	const char *userHome = values ? values->home : NULL;
+	const char *home = userHome;
+	int i;
 
-	if (!cache->dataHome)
+	xdgZeroMemory(source, sizeof(xdgCacheSource));
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
 	{
-		memcpy(value+homelen, DefaultRelativeDataHome, sizeof(DefaultRelativeDataHome));
-		cache->dataHome = strdup(value);
+		info = &xdgClasses[i];
+		source->homeSuffixes[i] = "";
+		source->lists[i] = info->defaults;
+		if (info->directoriesVariable && values && values->directories[i])
+			source->directories[i] = values->directories[i];
+		else if (info->directoriesVariable && useEnvironment)
+			source->directories[i] = xdgGetEnv(info->directoriesVariable);
+		if (values && (source->homes[i] = values->homes[i]))
+			continue;
+		if (!userHome && useEnvironment && (source->homes[i] = xdgGetEnv(info->homeVariable)))
+			continue;
+		if (!info->relativeHome)
+			continue;
+		if (!home && useEnvironment)
+			home = xdgGetEnv("HOME");
+		if (!home)
+		{
+			errno = EINVAL;
+			return FALSE;
+		}
+		source->homes[i] = home;
+		source->homeSuffixes[i] = info->relativeHome;
 	}
+	errno = 0;
+	return TRUE;
+}
 
-	if (!cache->configHome)
-	{
-		memcpy(value+homelen, DefaultRelativeConfigHome, sizeof(DefaultRelativeConfigHome));
-		cache->configHome = strdup(value);
-	}
+/** Gather the values for a cache of a clone, see xdgCloneHandle().
+ * Classes not named by overrides are shared with the parent, the others
+ * take what overrides does not set from the parent.
+ * @param source Structure receiving the values. They point into parent and overrides.
+ */
+static void xdgGetCloneSource(xdgCacheSource *source, xdgCachedData *parent, const xdgHandleValues *overrides)
+{
+	const xdgClassInfo *info;
+	int i;
 
-	if (!cache->cacheHome)
+	xdgZeroMemory(source, sizeof(xdgCacheSource));
+	source->parent = parent;
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
 	{
-		memcpy(value+homelen, DefaultRelativeCacheHome, sizeof(DefaultRelativeCacheHome));
-		cache->cacheHome = strdup(value);
+		info = &xdgClasses[i];
+		source->homeSuffixes[i] = "";
+		source->homes[i] = overrides->homes[i];
+		if (!source->homes[i] && overrides->home && info->relativeHome)
+		{
+			source->homes[i] = overrides->home;
+			source->homeSuffixes[i] = info->relativeHome;
+		}
+		if (info->directoriesVariable)
+			source->directories[i] = overrides->directories[i];
+		if (!source->homes[i] && !source->directories[i])
+		{
+			source->shared |= 1u << i;
+			continue;
+		}
+		if (!source->homes[i])
+			source->homes[i] = parent->homes[i];
+		/* the parent list starts with the home directory, unless it has none */
+		source->lists[i] = (const char **)parent->searchable[i] + !!parent->homes[i];
 	}
+}
 
-	free(value);
+/** Measure the memory needed to copy a directory list into a cache.
+ * @param string $PATH-style list of directories or NULL to use defaults.
+ * @param defaults NULL-terminated list of default directories.
+ * @param count Receives the maximum number of directories.
+ * @return The maximum number of bytes needed for the strings.
+ */
+static size_t xdgMeasureDirectoryList(const char *string, const char **defaults, unsigned int *count)
+{
+	size_t length = 0;
+	unsigned int i;
 
-	/* free does not change errno, and the prev call *must* have been a strdup,
-	 * so errno is already set. */
-	return cache->dataHome && cache->configHome && cache->cacheHome;
+	if (string)
+	{
+		/* every separator turns into a terminating null of the preceding item */
+		*count = 1;
+		for (i = 0; string[i]; ++i)
+			if (string[i] == PATH_SEPARATOR_CHAR) ++*count;
+		return i+1;
+	}
+	for (i = 0; defaults[i]; ++i)
+		length += strlen(defaults[i])+1;
+	*count = i;
+	return length;
 }
 
-/** Get directory lists with initial home directory.
- * @param envname Environment variable with colon-seperated directories.
- * @param homedir Home directory for this directory list or NULL. This
- *                parameter should be allocated on the heap. The returned list
- *                will start with this path, and should be considered as owning
- *                the memory.
- * @param defaults Default directories if environment variable is not set.
- * @return An array of strings. Both the array and its contents are allocated
- *         with malloc(). The function xdgFreeStringList is provided for
- *         conveniantly free()-ing the list and all its elements.
+/** Copy a directory list into cache memory.
+ * @param string $PATH-style list of directories or NULL to use defaults.
+ * @param defaults NULL-terminated list of default directories.
+ * @param items Receives pointers to the copied items followed by a NULL.
+ * @param buffer Memory for the strings, as measured by xdgMeasureDirectoryList().
+ * @return A pointer past the last byte of buffer used.
  */
-static char** xdgGetDirectoryLists(const char *envname, char *homedir, const char **defaults)
+static char * xdgCopyDirectoryList(const char *string, const char **defaults, char **items, char *buffer)
 {
-	char **envlist;
-	char **dirlist;
-	unsigned int size;
-
-	if (!(envlist = xdgGetPathListEnv(envname, defaults)))
-		return NULL;
+	size_t length;
 
-	for (size = 0; envlist[size]; size++) ; /* Get list size */
-	if (!(dirlist = (char**)malloc(sizeof(char*)*(size+1+!!homedir))))
+	if (!string)
 	{
-		xdgFreeStringList(envlist);
-		return NULL;
+		for (; *defaults; ++defaults, ++items)
+		{
+			length = strlen(*defaults)+1;
+			*items = memcpy(buffer, *defaults, length);
+			buffer += length;
+		}
+		*items = 0;
+		return buffer;
 	}
-	/* "home" directory has highest priority according to spec */
-	if (homedir)
-		dirlist[0] = homedir;
-	memcpy(dirlist+!!homedir, envlist, sizeof(char*)*(size+1));
-	/* only free the envlist since its elements are now referenced by dirlist */
-	free(envlist);
-
-	return dirlist;
+	while (*string)
+	{
+		*items = buffer;
+		/* transfer string, unescaping any escaped seperators */
+		for (; *string && *string != PATH_SEPARATOR_CHAR; ++string)
+		{
+#ifndef NO_ESCAPES_IN_PATHS
+			if (*string == '\\' && string[1] == PATH_SEPARATOR_CHAR) ++string; /* replace escaped ':' with just ':' */
+			else if (*string == '\\' && string[1]) /* skip escaped characters so escaping remains aligned to pairs. */
+				*buffer++ = *string++;
+#endif
+			*buffer++ = *string;
+		}
+		/* empty items are skipped, like unset variables they name no directory */
+		if (buffer != *items)
+		{
+			*buffer++ = 0;
+			++items;
+		}
+		if (*string == PATH_SEPARATOR_CHAR) string++; /* skip seperator */
+	}
+	*items = 0;
+	return buffer;
 }
 
-/** Update all *Directories variables of cache.
- * This includes xdgCachedData::searchableDataDirectories and xdgCachedData::searchableConfigDirectories.
- * @param cache Data cache to be updated.
+/** Copy the concatenation of two strings into cache memory.
+ * @return A pointer past the terminating null of the copy.
  */
-static int xdgUpdateDirectoryLists(xdgCachedData* cache)
+static char * xdgCopyConcatenation(char *buffer, const char *base, const char *suffix)
 {
-	if (!(cache->searchableDataDirectories = xdgGetDirectoryLists(
-			"XDG_DATA_DIRS", cache->dataHome, DefaultDataDirectoriesList)))
-		return FALSE;
-	if (!(cache->searchableConfigDirectories = xdgGetDirectoryLists(
-			"XDG_CONFIG_DIRS", cache->configHome, DefaultConfigDirectoriesList)))
-		return FALSE;
-
-	return TRUE;
+	size_t length = strlen(base);
+	memcpy(buffer, base, length);
+	buffer += length;
+	length = strlen(suffix)+1;
+	memcpy(buffer, suffix, length);
+	return buffer+length;
 }
 
-int xdgUpdateData(xdgHandle *handle)
+/** Get the directories of a class from the environment.
+ * The list and its strings are allocated in one block, so that it is
+ * freed with a single call to free(). The environment value is copied
+ * and split in one pass.
+ * Sets @c errno to @c EINVAL if a default home directory is needed and @c \$HOME is not set.
+ * @param dirClass @c XDG_CLASS_* constant.
+ * @param searchable Whether the list starts with the home directory.
+ * @return A null-terminated list, or NULL if an error occurs.
+ */
+static char** xdgGetDirectoryBlock(int dirClass, int searchable)
 {
-	xdgCachedData* cache = (xdgCachedData*)malloc(sizeof(xdgCachedData));
-	xdgCachedData* oldCache;
-	if (!cache) return FALSE;
-	xdgZeroMemory(cache, sizeof(xdgCachedData));
+	const xdgClassInfo *info = &xdgClasses[dirClass];
+	const char *home = NULL, *suffix = "", *dirs = NULL;
+	size_t length = 0;
+	unsigned int count;
+	char **list, *strings;
 
-	if (xdgUpdateHomeDirectories(cache) &&
-		xdgUpdateDirectoryLists(cache))
+	if (searchable)
 	{
-		/* Update successful, replace pointer to old cache with pointer to new cache */
-		oldCache = xdgGetCache(handle);
-		handle->reserved = cache;
-		if (oldCache)
+		home = xdgGetEnv(dirClass == XDG_CLASS_RUNTIME ? xdgNullRuntimeVariable : info->homeVariable);
+		if (!home && info->relativeHome)
 		{
-			xdgFreeData(oldCache);
-			free(oldCache);
+			if (!(home = xdgGetEnv("HOME")))
+				return NULL;
+			suffix = info->relativeHome;
 		}
-		return TRUE;
 	}
-	else
+	if (info->directoriesVariable)
+		dirs = xdgGetEnv(info->directoriesVariable);
+	errno = 0;
+
+	if (home)
+		length = strlen(home)+strlen(suffix)+1;
+	length += xdgMeasureDirectoryList(dirs, info->defaults, &count);
+	if (!(list = (char**)xdgMalloc(sizeof(char*)*(count+2) + length)))
+		return NULL;
+	strings = (char*)(list+count+2);
+	if (home)
 	{
-		/* Update failed, discard new cache and leave old cache unmodified */
-		xdgFreeData(cache);
-		free(cache);
-		return FALSE;
+		list[0] = strings;
+		strings = xdgCopyConcatenation(strings, home, suffix);
 	}
+	xdgCopyDirectoryList(dirs, info->defaults, list+!!home, strings);
+	return list;
+}
+
+/** Get a home directory from the environment or a fallback relative to @c \$HOME.
+ * Sets @c errno to @c ENOMEM if unable to allocate duplicate string.
+ * Sets @c errno to @c EINVAL if variable is not set or empty.
+ * @param envname Name of environment variable.
+ * @param relativefallback Path starting with "/" and relative to @c \$HOME to use as fallback.
+ * @param fallbacklength @c strlen(relativefallback).
+ * @return The home directory path or @c NULL of an error occurs.
+ */
+static char * xdgGetRelativeHome(const char *envname, const char *relativefallback, unsigned int fallbacklength)
+{
+	char *relhome;
+	if (!(relhome = xdgEnvDup(envname)) && errno != ENOMEM)
+	{
+		errno = 0;
+		const char *home;
+		unsigned int homelen;
+		if (!(home = xdgGetEnv("HOME")))
+			return NULL;
+		if (!(relhome = (char*)xdgMalloc((homelen = strlen(home))+fallbacklength+1))) return NULL;
+		memcpy(relhome, home, homelen);
+		memcpy(relhome+homelen, relativefallback, fallbacklength+1);
+	}
+	return relhome;
+}
+
+/** Get the home directory of a class for callers without a handle.
+ * @param dirClass @c XDG_CLASS_* constant.
+ * @return The home directory allocated using malloc(), or NULL with errno set.
+ */
+static char * xdgGetHome(int dirClass)
+{
+	const xdgClassInfo *info = &xdgClasses[dirClass];
+	if (!info->relativeHome)
+		return xdgEnvDup(dirClass == XDG_CLASS_RUNTIME ? xdgNullRuntimeVariable : info->homeVariable);
+	return xdgGetRelativeHome(info->homeVariable, info->relativeHome, strlen(info->relativeHome));
+}
+
+/** Get a directory list from the environment for callers without a handle.
+ * Every string is allocated separately, as callers free the items with
+ * free() before freeing the list.
+ * @param dirClass @c XDG_CLASS_* constant.
+ * @param searchable Whether the list starts with the home directory.
+ * @return A null-terminated list, or NULL if an error occurs.
+ */
+static char** xdgGetDirectoryList(int dirClass, int searchable)
+{
+	char **list, **result;
+	unsigned int count, i;
+
+	if (!(list = xdgGetDirectoryBlock(dirClass, searchable)))
+		return NULL;
+	for (count = 0; list[count]; ++count) ;
+	if ((result = (char**)xdgCalloc(count+1, sizeof(char*))))
+	{
+		for (i = 0; i < count; ++i)
+			if (!(result[i] = xdgStrdup(list[i])))
+			{
+				xdgFreeStringList(result);
+				result = NULL;
+				break;
+			}
+	}
+	free(list);
+	return result;
+}
+
+/** Directories of a class walked in place in the environment.
+ * Callers without a handle search directories one after the other, so
+ * instead of splitting the environment into a list each directory is
+ * joined to the relative path in a fixed buffer, see xdgNextCandidate().
+ */
+typedef struct _xdgDirectoryIterator
+{
+	/** Home directory not visited yet, or NULL. */
+	const char * home;
+	/** Appended to home, for a default relative to $HOME. */
+	const char * suffix;
+	/** Rest of the unsplit directory list, or NULL to use defaults. */
+	const char * string;
+	/** Default directories not visited yet. */
+	const char ** defaults;
+	/** Index of the current directory among the searchable directories. */
+	size_t index;
+	/** Length of the current directory in path, see xdgDirectoryLength(). */
+	size_t dirLength;
+	/** Path of the current candidate file. */
+	char path[PATH_MAX];
+} xdgDirectoryIterator;
+
+/** Start walking the searchable directories of a class, see xdgGetDirectoryBlock().
+ * Sets @c errno to @c EINVAL if a default home directory is needed and @c \$HOME is not set.
+ * @param it Iterator to initialize.
+ * @param dirClass @c XDG_CLASS_* constant.
+ * @return TRUE on success, FALSE if an error occurs.
+ */
+static int xdgStartDirectories(xdgDirectoryIterator *it, int dirClass)
+{
+	const xdgClassInfo *info = &xdgClasses[dirClass];
+
+	it->suffix = "";
+	it->home = xdgGetEnv(dirClass == XDG_CLASS_RUNTIME ? xdgNullRuntimeVariable : info->homeVariable);
+	if (!it->home && info->relativeHome)
+	{
+		if (!(it->home = xdgGetEnv("HOME")))
+			return FALSE;
+		it->suffix = info->relativeHome;
+	}
+	it->string = info->directoriesVariable ? xdgGetEnv(info->directoriesVariable) : NULL;
+	it->defaults = info->defaults;
+	it->index = (size_t)-1;
+	errno = 0;
+	return TRUE;
+}
+
+/** Append a string to the path of an iterator as far as it fits.
+ * @return The length the path would have, which may exceed the buffer.
+ */
+static size_t xdgAppendCandidate(xdgDirectoryIterator *it, size_t length, const char *string)
+{
+	for (; *string; ++string, ++length)
+		if (length < sizeof(it->path))
+			it->path[length] = *string;
+	return length;
+}
+
+/** Move to the next searchable directory and join it to a relative path.
+ * Items are unescaped and empty items skipped like in xdgCopyDirectoryList().
+ * Candidates that do not fit into xdgDirectoryIterator::path are skipped,
+ * as no file could be opened through such a path anyway.
+ * @param it Iterator started with xdgStartDirectories().
+ * @param relativePath Path relative to the directories.
+ * @param pathLen @c strlen(relativePath).
+ * @return The length of the candidate in xdgDirectoryIterator::path, or 0
+ * 	after the last directory.
+ */
+static size_t xdgNextCandidate(xdgDirectoryIterator *it, const char *relativePath, size_t pathLen)
+{
+	const char *string;
+	size_t length;
+
+	for (;;)
+	{
+		length = 0;
+		if (it->home)
+		{
+			length = xdgAppendCandidate(it, xdgAppendCandidate(it, 0, it->home), it->suffix);
+			it->home = NULL;
+		}
+		else if (it->string)
+		{
+			if (!*it->string)
+				return 0;
+			for (string = it->string; *string && *string != PATH_SEPARATOR_CHAR; ++string, ++length)
+			{
+#ifndef NO_ESCAPES_IN_PATHS
+				if (*string == '\\' && string[1] == PATH_SEPARATOR_CHAR) ++string;
+				else if (*string == '\\' && string[1])
+				{
+					if (length < sizeof(it->path))
+						it->path[length] = *string;
+					++string;
+					++length;
+				}
+#endif
+				if (length < sizeof(it->path))
+					it->path[length] = *string;
+			}
+			it->string = *string ? string+1 : string;
+			if (!length)
+				continue;
+		}
+		else if (*it->defaults)
+			length = xdgAppendCandidate(it, 0, *it->defaults++);
+		else
+			return 0;
+		++it->index;
+		if (length >= sizeof(it->path))
+			continue;
+		while (length && it->path[length-1] == DIR_SEPARATOR_CHAR) --length;
+		if (length+1+pathLen >= sizeof(it->path))
+			continue;
+		it->dirLength = length;
+		it->path[length] = DIR_SEPARATOR_CHAR;
+		memcpy(it->path+length+1, relativePath, pathLen+1);
+		return length+1+pathLen;
+	}
+}
+
+/** Remove repeated and trailing separators and "." components from a path in place. */
+static void xdgNormalizePath(char *path)
+{
+	char *source = path, *target = path;
+
+	while (*source)
+	{
+		if (*source != DIR_SEPARATOR_CHAR)
+		{
+			*target++ = *source++;
+			continue;
+		}
+		/* a run of separators and "." components becomes one separator */
+		while (*source == DIR_SEPARATOR_CHAR || (source[0] == '.' && source[-1] == DIR_SEPARATOR_CHAR &&
+			(source[1] == DIR_SEPARATOR_CHAR || !source[1])))
+			++source;
+		if (*source || target == path)
+			*target++ = DIR_SEPARATOR_CHAR;
+	}
+	*target = 0;
+}
+
+/** Drop duplicate and missing directories from a search list, as selected by flags.
+ * The first item, the home directory, is always kept unchanged.
+ * @param items NULL-terminated list, compacted in place.
+ * @param flags Bitwise or of @c XDG_HANDLE_* flags.
+ * @return TRUE if successful, FALSE if out of memory.
+ */
+static int xdgPruneDirectoryList(char **items, int flags)
+{
+	struct stat *stats;
+	unsigned char *exists;
+	size_t count, kept, i, j;
+
+	for (count = 0; items[count]; ++count) ;
+	if (!count) return TRUE;
+	if (!(stats = (struct stat*)xdgMalloc((sizeof(struct stat)+1)*count)))
+		return FALSE;
+	exists = (unsigned char*)(stats+count);
+	for (i = kept = 0; i < count; ++i)
+	{
+		if (i && (flags & XDG_HANDLE_DEDUPE))
+			xdgNormalizePath(items[i]);
+		exists[kept] = stat(items[i], &stats[kept]) == 0 && S_ISDIR(stats[kept].st_mode);
+		if (i && (flags & XDG_HANDLE_PRUNE_MISSING) && !exists[kept])
+			continue;
+		if (i && (flags & XDG_HANDLE_DEDUPE))
+		{
+			for (j = 0; j < kept; ++j)
+				if (strcmp(items[j], items[i]) == 0 || (exists[j] && exists[kept] &&
+					stats[j].st_dev == stats[kept].st_dev && stats[j].st_ino == stats[kept].st_ino))
+					break;
+			if (j < kept)
+				continue;
+		}
+		items[kept++] = items[i];
+	}
+	items[kept] = 0;
+	free(stats);
+	return TRUE;
+}
+
+/** Get the length of a directory path without its trailing separators.
+ * Paths are joined to relative paths with exactly one separator, so
+ * that @c "/usr/share/" and @c "/usr/share" give the same results and
+ * @c "/" has length 0.
+ */
+static size_t xdgDirectoryLength(const char *dir)
+{
+	size_t length = strlen(dir);
+	while (length && dir[length-1] == DIR_SEPARATOR_CHAR) --length;
+	return length;
+}
+
+/** Store xdgDirectoryLength() of each item in a directory list.
+ * @param dirList <tt>NULL</tt>-terminated list of directory paths.
+ * @param lengths Receives the lengths.
+ */
+static void xdgMeasureDirectories(char **dirList, size_t *lengths)
+{
+	for (; *dirList; ++dirList, ++lengths)
+		*lengths = xdgDirectoryLength(*dirList);
+}
+
+/** Open a directory file descriptor for each item in a directory list.
+ * Directories that cannot be opened get a descriptor of -1. The list is
+ * terminated by -2.
+ * @param dirList <tt>NULL</tt>-terminated list of directory paths.
+ * @param fds Receives the descriptors.
+ */
+static void xdgOpenFdList(char **dirList, int *fds)
+{
+	for (; *dirList; ++dirList, ++fds)
+#ifdef XDG_HAVE_DIRFDS
+		*fds = open(*dirList, XDG_DIRFD_OPEN_FLAGS);
+#else
+		*fds = -1;
+#endif
+	*fds = -2;
+}
+
+/** Allocate and fill a data cache.
+ * Everything the cache points to is allocated along with it in one block
+ * whose size is computed beforehand, so the cache can be freed with one
+ * call to free() (see xdgFreeCache()).
+ * @param source Values to build the cache from.
+ * @param flags Bitwise or of @c XDG_HANDLE_* flags.
+ * @return The new cache, or NULL if out of memory.
+ */
+static xdgCachedData * xdgNewCache(const xdgCacheSource *source, int flags)
+{
+	xdgCachedData *cache;
+	unsigned int counts[XDG_CLASS_COUNT];
+	size_t size, itemCount = 0, listCount = 0, fdCount, countCount = 0;
+	char **items, *strings;
+	int i;
+
+	size = sizeof(xdgCachedData);
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		if (xdgIsShared(source->shared, i))
+			continue;
+		if (source->homes[i])
+			size += strlen(source->homes[i])+strlen(source->homeSuffixes[i])+1;
+		size += xdgMeasureDirectoryList(source->directories[i], source->lists[i], &counts[i]);
+		/* each list has the home directory prepended and is NULL-terminated */
+		itemCount += counts[i]+2;
+		++listCount;
+	}
+	size += sizeof(char*)*itemCount + sizeof(size_t)*itemCount;
+	fdCount = flags & XDG_HANDLE_DIRFDS ? itemCount : 0;
+	size += sizeof(int)*fdCount;
+#ifdef ENABLE_STATS
+	countCount = 2*(itemCount-listCount);
+	size += sizeof(unsigned long)*countCount;
+#endif
+	/* clones are built from other caches, so there is nothing to record */
+	if (!source->parent)
+		for (i = 0; i < XDG_CLASS_COUNT; ++i)
+			if (source->directories[i])
+				size += strlen(source->directories[i])+1;
+
+	if (!(cache = (xdgCachedData*)xdgMalloc(size))) return NULL;
+	xdgZeroMemory(cache, sizeof(xdgCachedData));
+
+	/* pointers and counts first, then descriptors, then strings to keep everything aligned */
+	items = (char**)(cache+1);
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		if (xdgIsShared(source->shared, i)) continue;
+		cache->searchable[i] = items;
+		items += counts[i]+2;
+	}
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		if (xdgIsShared(source->shared, i)) continue;
+		cache->searchableLengths[i] = (size_t*)items;
+		items = (char**)(cache->searchableLengths[i]+counts[i]+2);
+	}
+	strings = (char*)items;
+	if (countCount)
+	{
+		xdgZeroMemory(strings, sizeof(unsigned long)*countCount);
+		for (i = 0; i < XDG_CLASS_COUNT; ++i)
+		{
+			if (xdgIsShared(source->shared, i)) continue;
+			cache->searchableCounts[i] = (unsigned long*)strings;
+			strings = (char*)(cache->searchableCounts[i]+2*(counts[i]+1));
+		}
+	}
+	if (fdCount)
+		for (i = 0; i < XDG_CLASS_COUNT; ++i)
+		{
+			if (xdgIsShared(source->shared, i)) continue;
+			cache->searchableFds[i] = (int*)strings;
+			strings = (char*)(cache->searchableFds[i]+counts[i]+2);
+		}
+
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+		if (source->homes[i] && !xdgIsShared(source->shared, i))
+		{
+			cache->homes[i] = strings;
+			strings = xdgCopyConcatenation(strings, source->homes[i], source->homeSuffixes[i]);
+		}
+
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		if (xdgIsShared(source->shared, i)) continue;
+		/* "home" directory has highest priority according to spec */
+		items = cache->searchable[i];
+		if (cache->homes[i])
+			*items++ = cache->homes[i];
+		strings = xdgCopyDirectoryList(source->directories[i], source->lists[i], items, strings);
+		if ((flags & (XDG_HANDLE_DEDUPE | XDG_HANDLE_PRUNE_MISSING)) &&
+			!xdgPruneDirectoryList(cache->searchable[i], flags))
+		{
+			free(cache);
+			return NULL;
+		}
+	}
+
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		if (xdgIsShared(source->shared, i))
+		{
+			cache->homes[i] = source->parent->homes[i];
+			cache->searchable[i] = source->parent->searchable[i];
+			cache->searchableFds[i] = source->parent->searchableFds[i];
+			cache->searchableCounts[i] = source->parent->searchableCounts[i];
+			cache->searchableLengths[i] = source->parent->searchableLengths[i];
+			continue;
+		}
+		xdgMeasureDirectories(cache->searchable[i], cache->searchableLengths[i]);
+		if (fdCount)
+			xdgOpenFdList(cache->searchable[i], cache->searchableFds[i]);
+	}
+	cache->refs = 1;
+	if ((cache->parent = source->parent))
+	{
+		cache->shared = source->shared;
+		xdgReferenceCache(cache->parent);
+	}
+	else
+	{
+		cache->recorded = TRUE;
+		for (i = 0; i < XDG_CLASS_COUNT; ++i)
+			if (source->directories[i])
+			{
+				cache->directories[i] = strings;
+				strings = xdgCopyConcatenation(strings, source->directories[i], "");
+			}
+	}
+	return cache;
+}
+
+static void xdgWatchDirectories(int watchFd, xdgWatchSet *watches, char ** dirList, const char * relativePath);
+static unsigned long long xdgMicroseconds(void);
+
+/** Check whether a cache was built from the values of a source.
+ * Home directories are compared with the concatenations of the source,
+ * directory lists with the values recorded by xdgNewCache().
+ * @param cache Cache to check, or NULL.
+ * @return TRUE if rebuilding the cache from source would give the same lists.
+ */
+static int xdgIsSameSource(const xdgCachedData *cache, const xdgCacheSource *source)
+{
+	size_t length;
+	int i;
+
+	if (!cache || !cache->recorded) return FALSE;
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		if (!source->homes[i] != !cache->homes[i] || !source->directories[i] != !cache->directories[i])
+			return FALSE;
+		if (source->directories[i] && strcmp(source->directories[i], cache->directories[i]) != 0)
+			return FALSE;
+		if (!source->homes[i])
+			continue;
+		length = strlen(source->homes[i]);
+		if (strncmp(source->homes[i], cache->homes[i], length) != 0 ||
+			strcmp(source->homeSuffixes[i], cache->homes[i]+length) != 0)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/** Reset the lookup caches of a handle for its new cache. */
+static void xdgUseCache(xdgHandleData *data, xdgCachedData *cache)
+{
+	int i;
+	/* cached lookups may refer to directories that are no longer searched */
+	xdgFlushLookups(&data->lookups);
+	xdgFlushListings(&data->listings);
+	if (data->flags & XDG_HANDLE_INDEX)
+		xdgLoadIndex(&data->index, cache);
+	if (data->watchFd >= 0)
+	{
+		/* directories that are no longer searched must not flush lookups */
+		xdgForgetWatches(&data->watches, data->watchFd);
+		for (i = 0; i < XDG_CLASS_COUNT; ++i)
+			xdgWatchDirectories(data->watchFd, &data->watches, cache->searchable[i], "");
+	}
+}
+
+/** Let the next update of a concurrent handle start, see xdgRebuildCache(). */
+static void xdgEndUpdate(xdgHandleData *data)
+{
+#ifdef XDG_HAVE_ATOMICS
+	if (data->flags & XDG_HANDLE_CONCURRENT)
+		__atomic_store_n(&data->updating, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+/** Rebuild the cache of a handle, see xdgUpdateData(). */
+static int xdgRebuildCache(xdgHandle *handle)
+{
+	xdgHandleData* data = xdgGetHandleData(handle);
+	xdgCacheSource source;
+	xdgCachedData* cache;
+	xdgCachedData* oldCache;
+#ifdef ENABLE_STATS
+	unsigned long long start = xdgMicroseconds();
+#endif
+#ifdef XDG_HAVE_ATOMICS
+	int concurrent = data->flags & XDG_HANDLE_CONCURRENT;
+
+	/* concurrent updates are serialized, reads are never blocked */
+	if (concurrent)
+		while (__atomic_exchange_n(&data->updating, 1, __ATOMIC_ACQUIRE))
+			xdgYield();
+#endif
+
+	/* On failure the old cache is left unmodified */
+	if (!xdgGetCacheSource(&source, data->values, data->useEnvironment))
+	{
+		xdgEndUpdate(data);
+		return FALSE;
+	}
+	/* pruned lists and directory descriptors depend on the file system as well */
+	if (!(data->flags & (XDG_HANDLE_DIRFDS | XDG_HANDLE_DEDUPE | XDG_HANDLE_PRUNE_MISSING)) &&
+		xdgIsSameSource(data->cache, &source))
+	{
+		xdgEndUpdate(data);
+		return XDG_UPDATE_UNCHANGED;
+	}
+
+	/* lookups made so far may not be valid for the new directories */
+	if (data->index.dirty)
+		xdgWriteIndex(data, data->cache);
+
+	if (!(cache = xdgNewCache(&source, data->flags)))
+	{
+		xdgEndUpdate(data);
+		return FALSE;
+	}
+
+	/* Update successful, replace old cache with new cache */
+	xdgCount(xdgStatistics.updates, 1);
+	xdgCount(xdgStatistics.updateMicroseconds, xdgMicroseconds()-start);
+#ifdef XDG_HAVE_ATOMICS
+	oldCache = __atomic_exchange_n(&data->cache, cache, __ATOMIC_SEQ_CST);
+	if (concurrent)
+	{
+		xdgSynchronizeReaders(data);
+		xdgFreeCache(oldCache);
+		xdgEndUpdate(data);
+		return XDG_UPDATE_REBUILT;
+	}
+#else
+	oldCache = data->cache;
+	data->cache = cache;
+#endif
+	xdgFreeCache(oldCache);
+	xdgUseCache(data, cache);
+	return XDG_UPDATE_REBUILT;
+}
+
+int xdgUpdateData(xdgHandle *handle)
+{
+	int ret;
+	xdgTrace1(update__entry, handle);
+	ret = xdgRebuildCache(handle);
+	xdgTrace2(update__return, handle, ret);
+	return ret;
+}
+
+xdgHandle * xdgCloneHandle(xdgHandle *clone, xdgHandle *handle, const xdgHandleValues *overrides)
+{
+	xdgHandleData *base = xdgGetHandleData(handle);
+	xdgHandleData *data;
+	xdgCacheSource source;
+	xdgCachedData *cache;
+	int ticket;
+
+	if (!clone || !(data = xdgNewHandleData(base->flags))) return 0;
+	data->useEnvironment = base->useEnvironment;
+	if ((base->values || overrides) && !(data->values = xdgCopyValues(base->values, overrides)))
+	{
+		xdgDeleteHandleData(data);
+		return 0;
+	}
+	/* the reference keeps the cache alive once concurrent updates replace it */
+	ticket = xdgBeginRead(handle);
+	cache = xdgGetCache(handle);
+	if (!overrides)
+		xdgReferenceCache(cache);
+	else
+	{
+		xdgGetCloneSource(&source, cache, overrides);
+		cache = xdgNewCache(&source, data->flags);
+	}
+	xdgEndRead(handle, ticket);
+	if (!cache)
+	{
+		xdgDeleteHandleData(data);
+		return 0;
+	}
+	data->cache = cache;
+	clone->reserved = data;
+	xdgUseCache(data, cache);
+	return clone;
+}
+
+/** Get the current time of a monotonic clock in microseconds. */
+static unsigned long long xdgMicroseconds(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC)
+	struct timespec now;
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+		return (unsigned long long)now.tv_sec*1000000 + now.tv_nsec/1000;
+#endif
+	return (unsigned long long)time(NULL)*1000000;
+}
+
+/** Get the current time of a monotonic clock in milliseconds. */
+static unsigned long long xdgNow(void)
+{
+	return xdgMicroseconds()/1000;
+}
+
+/** Combine a directory class and probe flags into a lookup cache key. */
+static int xdgLookupKind(int dirClass, int flags)
+{
+	return (flags << XDG_CLASS_BITS) | dirClass;
+}
+
+/** Hash a lookup cache key (FNV-1a). */
+static unsigned int xdgHashLookup(const char * relativePath, int kind)
+{
+	unsigned int hash = 2166136261u ^ (unsigned int)kind;
+	for (; *relativePath; ++relativePath)
+		hash = (hash ^ (unsigned char)*relativePath) * 16777619u;
+	return hash;
+}
+
+/** Get the length of a double-null terminated string list including both terminators. */
+static size_t xdgStringListLength(const char * strings)
+{
+	const char * ptr = strings;
+	while (*ptr)
+		ptr += strlen(ptr)+1;
+	return ptr-strings+1;
+}
+
+/** Remove all entries from a lookup cache. */
+static void xdgFlushLookups(xdgLookupCache *lookups)
+{
+	xdgLookupEntry *entry, *next;
+	unsigned int i;
+
+	for (i = 0; i < lookups->bucketCount; ++i)
+	{
+		for (entry = lookups->buckets[i]; entry; entry = next)
+		{
+			next = entry->next;
+			free(entry);
+		}
+		lookups->buckets[i] = 0;
+	}
+	lookups->entryCount = 0;
+}
+
+/** Remove all listings from a listing cache. */
+static void xdgFlushListings(xdgListingCache *listings)
+{
+	xdgListing *listing, *next;
+	unsigned int i;
+
+	if (!listings->buckets) return;
+	for (i = 0; i < XDG_LISTING_CACHE_BUCKETS; ++i)
+	{
+		for (listing = listings->buckets[i]; listing; listing = next)
+		{
+			next = listing->next;
+			free(listing);
+		}
+		listings->buckets[i] = 0;
+	}
+	listings->entryCount = 0;
+}
+
+/** Look up a cached find result.
+  * Stale entries met on the way are removed.
+  * @param buffer Receives a copy of the result if it fits.
+  * @param size Size of buffer.
+  * @return The size of the cached result, or 0 if there is no usable entry.
+  */
+static size_t xdgGetCachedLookup(xdgLookupCache *lookups, const char * relativePath, int kind,
+	char * buffer, size_t size)
+{
+	xdgLookupEntry **link, *entry;
+	unsigned int hash;
+	unsigned long long now = 0;
+
+	if (!lookups->entryCount) return 0;
+	hash = xdgHashLookup(relativePath, kind);
+	for (link = &lookups->buckets[hash%lookups->bucketCount]; (entry = *link); )
+	{
+		if (entry->expires && entry->expires <= (now ? now : (now = xdgNow())))
+		{
+			*link = entry->next;
+			free(entry);
+			--lookups->entryCount;
+			continue;
+		}
+		if (entry->hash == hash && entry->kind == kind && strcmp(entry->data, relativePath) == 0)
+		{
+			if (entry->resultLength <= size)
+				memcpy(buffer, entry->data+strlen(entry->data)+1, entry->resultLength);
+			return entry->resultLength;
+		}
+		link = &entry->next;
+	}
+	return 0;
+}
+
+/** Add a find result to a lookup cache.
+  * Failure to store the result is not an error, the lookup will just
+  * be performed again next time.
+  */
+static void xdgStoreLookup(xdgLookupCache *lookups, const char * relativePath, int kind, const char * result)
+{
+	xdgLookupEntry **buckets, *entry, *next;
+	unsigned int count, i;
+	size_t pathLength = strlen(relativePath)+1;
+	size_t resultLength = xdgStringListLength(result);
+
+	if (lookups->entryCount >= XDG_LOOKUP_CACHE_MAX_ENTRIES)
+		xdgFlushLookups(lookups);
+	if (lookups->entryCount >= lookups->bucketCount)
+	{
+		/* grow and rehash */
+		count = MAX(lookups->bucketCount*2, XDG_LOOKUP_CACHE_MIN_BUCKETS);
+		if (!(buckets = (xdgLookupEntry**)xdgMalloc(sizeof(xdgLookupEntry*)*count))) return;
+		xdgZeroMemory(buckets, sizeof(xdgLookupEntry*)*count);
+		for (i = 0; i < lookups->bucketCount; ++i)
+		{
+			for (entry = lookups->buckets[i]; entry; entry = next)
+			{
+				next = entry->next;
+				entry->next = buckets[entry->hash%count];
+				buckets[entry->hash%count] = entry;
+			}
+		}
+		free(lookups->buckets);
+		lookups->buckets = buckets;
+		lookups->bucketCount = count;
+	}
+
+	if (!(entry = (xdgLookupEntry*)xdgMalloc(sizeof(xdgLookupEntry)+pathLength+resultLength))) return;
+	entry->hash = xdgHashLookup(relativePath, kind);
+	entry->kind = kind;
+	entry->expires = lookups->ttl ? xdgNow()+lookups->ttl : 0;
+	entry->resultLength = resultLength;
+	memcpy(entry->data, relativePath, pathLength);
+	memcpy(entry->data+pathLength, result, resultLength);
+	entry->next = lookups->buckets[entry->hash%lookups->bucketCount];
+	lookups->buckets[entry->hash%lookups->bucketCount] = entry;
+	++lookups->entryCount;
+}
+
+#if HAVE_SYS_INOTIFY_H
+/** Events that may change the outcome of a lookup in the watched directory. */
+#define XDG_WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+	IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+/** Remove all directories from a watch set.
+  * @param watches Watch set to empty.
+  * @param watchFd inotify file descriptor to remove the watches from, or
+  * 	-1 to only forget them.
+  */
+static void xdgForgetWatches(xdgWatchSet *watches, int watchFd)
+{
+	xdgWatch *watch, *next;
+	unsigned int i;
+
+	if (!watches->buckets) return;
+	for (i = 0; i < XDG_WATCH_BUCKETS; ++i)
+	{
+		for (watch = watches->buckets[i]; watch; watch = next)
+		{
+			next = watch->next;
+#if HAVE_SYS_INOTIFY_H
+			if (watchFd >= 0 && watch->wd != -1)
+				inotify_rm_watch(watchFd, watch->wd);
+#endif
+			free(watch);
+		}
+		watches->buckets[i] = 0;
+	}
+	watches->entryCount = 0;
+}
+
+#if HAVE_SYS_INOTIFY_H
+/** Remove the directories with a watch descriptor from a watch set.
+  * @param wd Watch descriptor, -1 selects the directories that could not be watched.
+  * @return TRUE if any directory was removed, else FALSE.
+  */
+static int xdgDropWatches(xdgWatchSet *watches, int wd)
+{
+	xdgWatch **link, *watch;
+	unsigned int i;
+	int found = FALSE;
+
+	if (!watches->buckets) return FALSE;
+	for (i = 0; i < XDG_WATCH_BUCKETS; ++i)
+	{
+		for (link = &watches->buckets[i]; (watch = *link); )
+		{
+			if (watch->wd != wd)
+			{
+				link = &watch->next;
+				continue;
+			}
+			*link = watch->next;
+			free(watch);
+			--watches->entryCount;
+			found = TRUE;
+		}
+	}
+	return found;
+}
+
+/** Watch a directory unless it is in the watch set already.
+  * Failure to remember the directory only means that it is added again
+  * the next time.
+  * @return TRUE if the directory is watched, else FALSE.
+  */
+static int xdgWatchPath(int watchFd, xdgWatchSet *watches, const char * path)
+{
+	unsigned int hash = xdgHashLookup(path, 0);
+	size_t length = strlen(path)+1;
+	xdgWatch *watch;
+	int wd;
+
+	if (!watches->buckets)
+		watches->buckets = (xdgWatch**)xdgCalloc(XDG_WATCH_BUCKETS, sizeof(xdgWatch*));
+	if (watches->buckets)
+	{
+		for (watch = watches->buckets[hash%XDG_WATCH_BUCKETS]; watch; watch = watch->next)
+			if (watch->hash == hash && strcmp(watch->path, path) == 0)
+				return watch->wd != -1;
+	}
+	wd = inotify_add_watch(watchFd, path, XDG_WATCH_EVENTS);
+	if (watches->buckets && (watch = (xdgWatch*)xdgMalloc(sizeof(xdgWatch)+length)))
+	{
+		watch->hash = hash;
+		watch->wd = wd;
+		memcpy(watch->path, path, length);
+		watch->next = watches->buckets[hash%XDG_WATCH_BUCKETS];
+		watches->buckets[hash%XDG_WATCH_BUCKETS] = watch;
+		++watches->entryCount;
+	}
+	return wd != -1;
+}
+#endif
+
+/** Watch every directory a candidate path is resolved through below its base directory.
+  * If the base directory itself does not exist, its deepest existing
+  * ancestor is watched instead so that its creation is noticed.
+  * Directories in the watch set are not added again, and failure to add
+  * watches is not an error.
+  * @param watchFd inotify file descriptor.
+  * @param watches Directories watched already.
+  * @param baseDir Base directory of the candidate.
+  * @param relativePath Candidate path relative to baseDir.
+  */
+static void xdgWatchCandidate(int watchFd, xdgWatchSet *watches, const char * baseDir, const char * relativePath)
+{
+#if HAVE_SYS_INOTIFY_H
+	char pathBuffer[PATH_MAX];
+	char * path = pathBuffer;
+	const char * component;
+	size_t length = strlen(baseDir);
+	size_t size = length+strlen(relativePath)+2;
+
+	if (size > sizeof(pathBuffer) && !(path = (char*)xdgMalloc(size))) return;
+	memcpy(path, baseDir, length+1);
+	if (!xdgWatchPath(watchFd, watches, path))
+	{
+		while (length > 1)
+		{
+			while (length > 1 && path[length-1] != DIR_SEPARATOR_CHAR) --length;
+			while (length > 1 && path[length-1] == DIR_SEPARATOR_CHAR) --length;
+			path[length] = 0;
+			if (xdgWatchPath(watchFd, watches, path))
+				break;
+		}
+	}
+	else
+	{
+		/* only the directories leading to the candidate, not the candidate itself */
+		for (component = relativePath; (component = strchr(component, DIR_SEPARATOR_CHAR)); ++component)
+		{
+			path[length] = DIR_SEPARATOR_CHAR;
+			memcpy(path+length+1, relativePath, component-relativePath);
+			path[length+1+(component-relativePath)] = 0;
+			if (!xdgWatchPath(watchFd, watches, path))
+				break;
+		}
+	}
+	if (path != pathBuffer)
+		free(path);
+#endif
+}
+
+/** Watch the candidate directories of relativePath relative to each item in dirList.
+  * See xdgWatchCandidate().
+  */
+static void xdgWatchDirectories(int watchFd, xdgWatchSet *watches, char ** dirList, const char * relativePath)
+{
+	for (; *dirList; ++dirList)
+		xdgWatchCandidate(watchFd, watches, *dirList, relativePath);
+}
+
+int xdgEventFd(xdgHandle *handle)
+{
+	return xdgGetHandleData(handle)->watchFd;
+}
+
+int xdgProcessEvents(xdgHandle *handle)
+{
+#if HAVE_SYS_INOTIFY_H
+	xdgHandleData *data = xdgGetHandleData(handle);
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	ssize_t length;
+	char *ptr;
+	int count = 0;
+
+	if (data->watchFd < 0) return 0;
+	while ((length = read(data->watchFd, buffer, sizeof(buffer))) > 0)
+	{
+		for (ptr = buffer; ptr < buffer+length; ptr += sizeof(struct inotify_event)+event->len)
+		{
+			event = (const struct inotify_event*)ptr;
+			/* watches removed along with a replaced cache are not changes */
+			if ((event->mask & IN_IGNORED) && !xdgDropWatches(&data->watches, event->wd))
+				continue;
+			/* events may have been lost, including removals of watches */
+			if (event->mask & IN_Q_OVERFLOW)
+				xdgForgetWatches(&data->watches, -1);
+			++count;
+		}
+	}
+	if (length == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		return -1;
+	/* directories that could not be watched may have been created since */
+	if (count)
+		xdgDropWatches(&data->watches, -1);
+	/* Any change in a watched directory, including a queue overflow,
+	 * flushes everything. Changes are rare enough for this to be cheaper
+	 * than tracking which entries depend on which directory. */
+	if (count)
+	{
+		xdgFlushLookups(&data->lookups);
+		xdgFlushListings(&data->listings);
+		xdgValidateIndex(&data->index, data->cache);
+	}
+	return count;
+#else
+	return 0;
+#endif
+}
+
+void xdgFlushLookupCache(xdgHandle *handle)
+{
+	xdgHandleData *data = xdgGetHandleData(handle);
+	xdgFlushLookups(&data->lookups);
+	xdgFlushListings(&data->listings);
+	/* indexed results stay usable as far as their stamps still match */
+	xdgValidateIndex(&data->index, data->cache);
+}
+
+void xdgSetLookupCacheTTL(xdgHandle *handle, unsigned int milliseconds)
+{
+	xdgHandleData *data = xdgGetHandleData(handle);
+	data->lookups.ttl = milliseconds;
+	/* entries stored under the old lifetime could otherwise outlive the new one */
+	xdgFlushLookups(&data->lookups);
+	xdgFlushListings(&data->listings);
+}
+
+/** Record the outcome of testing a directory for a relative path.
+  * @param dirCounts Hit and miss counts for each item in dirList, or NULL.
+  * @param relativePath Relative path that was tested.
+  * @param dirList <tt>NULL</tt>-terminated list of directory paths.
+  * @param index Index of the tested directory in dirList.
+  * @param found Whether the path was found in the directory.
+  */
+static void xdgProbed(unsigned long * dirCounts, const char * relativePath, const char * const * dirList,
+	size_t index, int found)
+{
+	if (dirCounts)
+		xdgCount(dirCounts[2*index + !found], 1);
+	xdgTrace4(probe, relativePath, index, dirList[index], found);
+}
+
+/** Trace a probe of the current candidate of an iterator, see xdgProbed(). */
+static void xdgProbedCandidate(xdgDirectoryIterator *it, const char * relativePath, int found)
+{
+#if HAVE_SYS_SDT_H
+	/* cut the candidate short so that the directory is traced */
+	it->path[it->dirLength] = 0;
+	xdgTrace4(probe, relativePath, it->index, it->path, found);
+	it->path[it->dirLength] = DIR_SEPARATOR_CHAR;
+#else
+	(void)it;
+	(void)relativePath;
+	(void)found;
+#endif
+}
+
+/** Test whether a candidate file satisfies the requested probe mode.
+  * @param fullPath Path of the candidate file.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @return TRUE if the file should be considered found, else FALSE.
+  */
+static int xdgProbeFile(const char * fullPath, int flags)
+{
+	struct stat st;
+	FILE * testFile;
+
+	xdgCount(xdgStatistics.probes, 1);
+	if (flags & XDG_FIND_FOPEN)
+	{
+		if (!(testFile = fopen(fullPath, "r")))
+			return FALSE;
+		if ((flags & XDG_FIND_REGULAR) && (fstat(fileno(testFile), &st) == -1 || !S_ISREG(st.st_mode)))
+		{
+			fclose(testFile);
+			return FALSE;
+		}
+		fclose(testFile);
+		return TRUE;
+	}
+	if (flags & XDG_FIND_REGULAR)
+	{
+		if (stat(fullPath, &st) == -1 || !S_ISREG(st.st_mode))
+			return FALSE;
+		if (flags & XDG_FIND_EXISTS)
+			return TRUE;
+	}
+	else if (flags & XDG_FIND_EXISTS)
+		return access(fullPath, F_OK) == 0;
+#if HAVE_FACCESSAT || !defined(HAVE_CONFIG_H)
+	/* Check against the effective ids, as fopen() would. */
+	return faccessat(AT_FDCWD, fullPath, R_OK, AT_EACCESS) == 0;
+#else
+	return access(fullPath, R_OK) == 0;
+#endif
+}
+
+/** Get the part of relativePath to be resolved against a directory file descriptor.
+  * Leading separators are skipped so the path stays relative to the
+  * descriptor, just as when it is appended to the directory name.
+  */
+static const char * xdgRelativeToFd(const char * relativePath)
+{
+	while (*relativePath == DIR_SEPARATOR_CHAR)
+		++relativePath;
+	return *relativePath ? relativePath : ".";
+}
+
+#ifdef XDG_HAVE_DIRFDS
+/** Test whether a file relative to a directory satisfies the requested probe mode.
+  * @param dirFd Open file descriptor of the base directory.
+  * @param relativePath Path of the candidate file relative to dirFd, see xdgRelativeToFd().
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @return TRUE if the file should be considered found, else FALSE.
+  */
+static int xdgProbeFileAt(int dirFd, const char * relativePath, int flags)
+{
+	struct stat st;
+	int fd;
+
+	xdgCount(xdgStatistics.probes, 1);
+	if (flags & XDG_FIND_FOPEN)
+	{
+		if ((fd = openat(dirFd, relativePath, O_RDONLY | O_CLOEXEC)) == -1)
+			return FALSE;
+		if ((flags & XDG_FIND_REGULAR) && (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)))
+		{
+			close(fd);
+			return FALSE;
+		}
+		close(fd);
+		return TRUE;
+	}
+	if (flags & XDG_FIND_REGULAR)
+	{
+		if (fstatat(dirFd, relativePath, &st, 0) == -1 || !S_ISREG(st.st_mode))
+			return FALSE;
+		if (flags & XDG_FIND_EXISTS)
+			return TRUE;
+	}
+	else if (flags & XDG_FIND_EXISTS)
+		return faccessat(dirFd, relativePath, F_OK, 0) == 0;
+	return faccessat(dirFd, relativePath, R_OK, AT_EACCESS) == 0;
+}
+
+/** Translate an fopen() mode string into open() flags.
+  * @return The flags, or -1 if the mode is not understood.
+  */
+static int xdgModeToOpenFlags(const char * mode)
+{
+	int flags;
+	const char * c;
+
+	switch (*mode)
+	{
+	case 'r': flags = 0; break;
+	case 'w': flags = O_CREAT | O_TRUNC; break;
+	case 'a': flags = O_CREAT | O_APPEND; break;
+	default: return -1;
+	}
+	if (strchr(mode, '+'))
+		flags |= O_RDWR;
+	else
+		flags |= (*mode == 'r' ? O_RDONLY : O_WRONLY);
+	for (c = mode+1; *c; ++c)
+	{
+		if (*c == 'x') flags |= O_EXCL;
+		else if (*c == 'e') flags |= O_CLOEXEC;
+	}
+	return flags;
+}
+#endif
+
+/** Join a directory of known length and a relative path with a separator between them.
+  * @param buffer Receives the joined path if it fits.
+  * @param size Size of buffer.
+  * @param dir Directory path.
+  * @param dirLen xdgDirectoryLength() of dir.
+  * @param relativePath Path relative to dir.
+  * @param pathLen @c strlen(relativePath).
+  * @return The length of the joined path, excluding the terminating null.
+  */
+static size_t xdgJoinMeasured(char * buffer, size_t size, const char * dir, size_t dirLen,
+	const char * relativePath, size_t pathLen)
+{
+	if (dirLen+1+pathLen < size)
+	{
+		memcpy(buffer, dir, dirLen);
+		buffer[dirLen] = DIR_SEPARATOR_CHAR;
+		memcpy(buffer+dirLen+1, relativePath, pathLen+1);
+	}
+	return dirLen+1+pathLen;
+}
+
+/** Join a directory and a relative path with a separator between them.
+  * @param buffer Receives the joined path if it fits.
+  * @param size Size of buffer.
+  * @param dir Directory path.
+  * @param relativePath Path relative to dir.
+  * @return The length of the joined path, excluding the terminating null.
+  */
+static size_t xdgJoinPath(char * buffer, size_t size, const char * dir, const char * relativePath)
+{
+	return xdgJoinMeasured(buffer, size, dir, xdgDirectoryLength(dir), relativePath, strlen(relativePath));
+}
+
+/** Move a find result into a larger heap buffer.
+  * @param buffer Buffer holding the result, replaced by the larger one.
+  * @param size Size of buffer, updated.
+  * @param used Number of bytes of the result so far.
+  * @param needed Number of bytes needed after those.
+  * @param grown Heap buffer, or NULL while buffer is the caller's. Receives the larger buffer.
+  * @return TRUE on success, FALSE with errno set if memory cannot be allocated.
+  */
+static int xdgGrowResult(char ** buffer, size_t * size, size_t used, size_t needed, char ** grown)
+{
+	size_t newSize = *size*2 > used+needed ? *size*2 : used+needed;
+	char * result;
+
+	if (!(result = (char*)xdgRealloc(*grown, newSize)))
+		return FALSE;
+	if (!*grown)
+		memcpy(result, *buffer, used);
+	*buffer = *grown = result;
+	*size = newSize;
+	return TRUE;
 }
 
 /** Find all existing files corresponding to relativePath relative to each item in dirList.
+  * Candidate paths are built in place in buffer, or in a stack buffer once
+  * buffer is full, so no memory is allocated unless a path exceeds @c PATH_MAX
+  * or the result is moved to the heap.
+  * @param relativePath Relative path to search for.
+  * @param dirList <tt>NULL</tt>-terminated list of directory paths.
+  * @param dirLengths xdgDirectoryLength() of each item in dirList, or NULL to measure them.
+  * @param dirFds List of directory file descriptors parallel to dirList, or NULL.
+  * @param dirCounts Hit and miss counts for each item in dirList, or NULL.
+  * @param dirHints @c XDG_HINT_* constants for each item in dirList, or NULL to probe all.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @param buffer Receives a sequence of null-terminated strings terminated
+  * 	by a double-<tt>NULL</tt> (empty string), if it fits.
+  * @param size Size of buffer.
+  * @param grown NULL to only measure a result that does not fit into buffer.
+  * 	Otherwise such a result is moved to a heap buffer as it is found, see
+  * 	xdgGrowResult(), and this receives that buffer or stays NULL. The
+  * 	caller frees it, also on error.
+  * @return The size of the complete result, or 0 on error.
+  */
+static size_t xdgFindExisting(const char * relativePath, const char * const * dirList, const size_t * dirLengths,
+	const int * dirFds, unsigned long * dirCounts, const signed char * dirHints, int flags,
+	char * buffer, size_t size, char ** grown)
+{
+	char pathBuffer[PATH_MAX];
+	char * fullPath;
+	size_t used = 0;
+	size_t length, dirLen;
+	size_t pathLen = strlen(relativePath);
+	int found, inPlace;
+	const char * const * item;
+
+	xdgTrace2(find__entry, relativePath, flags);
+	for (item = dirList; *item; item++)
+	{
+		found = -1;
+		if (dirHints && dirHints[item-dirList] != XDG_HINT_PROBE)
+		{
+			/* answered by a directory listing */
+			if (dirHints[item-dirList] == XDG_HINT_ABSENT)
+				continue;
+			found = TRUE;
+		}
+#ifdef XDG_HAVE_DIRFDS
+		/* with an open directory the full path is only needed for hits */
+		else if (dirFds && dirFds[item-dirList] >= 0)
+		{
+			found = xdgProbeFileAt(dirFds[item-dirList], xdgRelativeToFd(relativePath), flags);
+			xdgProbed(dirCounts, relativePath, dirList, item-dirList, found);
+			if (!found)
+				continue;
+		}
+#endif
+		dirLen = dirLengths ? dirLengths[item-dirList] : xdgDirectoryLength(*item);
+		length = dirLen+1+pathLen;
+		inPlace = used+length+1 < size;
+		if (inPlace)
+			fullPath = buffer+used;
+		else if (length < sizeof(pathBuffer))
+			fullPath = pathBuffer;
+		else if (!(fullPath = (char*)xdgMalloc(length+1)))
+		{
+			xdgTrace2(find__return, relativePath, 0);
+			return 0;
+		}
+		xdgJoinMeasured(fullPath, length+1, *item, dirLen, relativePath, pathLen);
+		if (found == -1)
+		{
+			found = xdgProbeFile(fullPath, flags);
+			xdgProbed(dirCounts, relativePath, dirList, item-dirList, found);
+		}
+		if (found && !inPlace && grown)
+		{
+			if (!xdgGrowResult(&buffer, &size, used, length+2, grown))
+			{
+				if (fullPath != pathBuffer)
+					free(fullPath);
+				xdgTrace2(find__return, relativePath, 0);
+				return 0;
+			}
+			memcpy(buffer+used, fullPath, length+1);
+		}
+		if (!inPlace && fullPath != pathBuffer)
+			free(fullPath);
+		if (found)
+		{
+			used += length+1;
+			if (flags & XDG_FIND_FIRST)
+				break;
+		}
+	}
+	if (used < size)
+		buffer[used] = 0;
+	xdgTrace2(find__return, relativePath, used+1);
+	return used+1;
+}
+
+/** Find the existing files corresponding to each of several relative paths.
+  * Every directory of dirList is visited once, testing all paths against it.
+  * @param relativePaths Relative paths to search for.
+  * @param count Number of items in relativePaths.
+  * @param dirList <tt>NULL</tt>-terminated list of directory paths.
+  * @param dirLengths xdgDirectoryLength() of each item in dirList, or NULL to measure them.
+  * @param dirFds List of directory file descriptors parallel to dirList, or NULL.
+  * @param dirCounts Hit and miss counts for each item in dirList, or NULL.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @return An array of count results in the format of xdgDataFind(),
+  * 	allocated together with the strings using a single malloc().
+  */
+static char ** xdgFindManyExisting(const char * const * relativePaths, size_t count,
+	const char * const * dirList, const size_t * dirLengths, const int * dirFds, unsigned long * dirCounts, int flags)
+{
+	size_t dirCount, dirLen, length, size, i, d;
+	size_t fullSize = 0;
+	size_t * pathLengths;
+	char * fullPath = 0;
+	char * tmpString;
+	unsigned char * hits;
+	char ** result;
+	char * ptr;
+	int found;
+
+	for (dirCount = 0; dirList[dirCount]; ++dirCount);
+	/* count comes from the caller, so the array sizes below may overflow */
+	if ((dirCount && count > ((size_t)-1-1)/dirCount) ||
+		count > ((size_t)-1-1)/sizeof(size_t)-dirCount ||
+		count > (size_t)-1/(sizeof(char*)+1))
+	{
+		errno = ENOMEM;
+		return 0;
+	}
+	/* path lengths are needed for every directory, and directory lengths twice */
+	if (!(pathLengths = (size_t*)xdgMalloc(sizeof(size_t)*(count+dirCount)+1)))
+		return 0;
+	if (!(hits = (unsigned char*)xdgCalloc(dirCount*count+1, 1)))
+	{
+		free(pathLengths);
+		return 0;
+	}
+	for (i = 0; i < count; ++i)
+		pathLengths[i] = strlen(relativePaths[i]);
+	for (d = 0; d < dirCount; ++d)
+		pathLengths[count+d] = dirLengths ? dirLengths[d] : xdgDirectoryLength(dirList[d]);
+	/* one slot per result plus its terminating empty string */
+	size = count*(sizeof(char*)+1);
+	for (d = 0; d < dirCount; ++d)
+	{
+		dirLen = pathLengths[count+d];
+		for (i = 0; i < count; ++i)
+		{
+			length = dirLen+1+pathLengths[i];
+#ifdef XDG_HAVE_DIRFDS
+			if (dirFds && dirFds[d] >= 0)
+				found = xdgProbeFileAt(dirFds[d], xdgRelativeToFd(relativePaths[i]), flags);
+			else
+#endif
+			{
+				if (length+1 > fullSize)
+				{
+					if (!(tmpString = (char*)xdgRealloc(fullPath, length+1)))
+					{
+						free(fullPath);
+						free(hits);
+						free(pathLengths);
+						return 0;
+					}
+					fullPath = tmpString;
+					fullSize = length+1;
+				}
+				xdgJoinMeasured(fullPath, fullSize, dirList[d], dirLen, relativePaths[i], pathLengths[i]);
+				found = xdgProbeFile(fullPath, flags);
+			}
+			xdgProbed(dirCounts, relativePaths[i], dirList, d, found);
+			if (found)
+			{
+				hits[d*count+i] = 1;
+				size += length+1;
+			}
+		}
+	}
+	free(fullPath);
+
+	if (!(result = (char**)xdgMalloc(size ? size : 1)))
+	{
+		free(hits);
+		free(pathLengths);
+		return 0;
+	}
+	ptr = (char*)(result+count);
+	for (i = 0; i < count; ++i)
+	{
+		result[i] = ptr;
+		for (d = 0; d < dirCount; ++d)
+		{
+			if (!hits[d*count+i]) continue;
+			/* the space was counted above, so the join always fits */
+			ptr += xdgJoinMeasured(ptr, (size_t)-1, dirList[d], pathLengths[count+d],
+				relativePaths[i], pathLengths[i])+1;
+		}
+		*ptr++ = 0;
+	}
+	free(hits);
+	free(pathLengths);
+	return result;
+}
+
+/** Open first possible config file corresponding to relativePath.
+  * @param relativePath Path to scan for.
+  * @param mode Mode with which to attempt to open files (see fopen modes).
+  * @param dirList <tt>NULL</tt>-terminated list of paths in which to search for relativePath.
+  * @param dirLengths xdgDirectoryLength() of each item in dirList, or NULL to measure them.
+  * @param dirFds List of directory file descriptors parallel to dirList, or NULL.
+  * @param dirCounts Hit and miss counts for each item in dirList, or NULL.
+  * @return File pointer if successful else @c NULL. Client must use @c fclose to close file.
+  */
+static FILE * xdgFileOpenUntraced(const char * relativePath, const char * mode, const char * const * dirList,
+	const size_t * dirLengths, const int * dirFds, unsigned long * dirCounts)
+{
+	char pathBuffer[PATH_MAX];
+	char * fullPath;
+	size_t length, dirLen;
+	size_t pathLen = strlen(relativePath);
+	FILE * testFile;
+	const char * const * item;
+#ifdef XDG_HAVE_DIRFDS
+	int openFlags = dirFds ? xdgModeToOpenFlags(mode) : -1;
+	int fd;
+#endif
+
+	for (item = dirList; *item; item++)
+	{
+#ifdef XDG_HAVE_DIRFDS
+		if (openFlags != -1 && dirFds[item-dirList] >= 0)
+		{
+			xdgCount(xdgStatistics.probes, 1);
+			fd = openat(dirFds[item-dirList], xdgRelativeToFd(relativePath), openFlags, 0666);
+			xdgProbed(dirCounts, relativePath, dirList, item-dirList, fd != -1);
+			if (fd == -1)
+				continue;
+			if (!(testFile = fdopen(fd, mode)))
+				close(fd);
+			return testFile;
+		}
+#endif
+		dirLen = dirLengths ? dirLengths[item-dirList] : xdgDirectoryLength(*item);
+		length = xdgJoinMeasured(pathBuffer, sizeof(pathBuffer), *item, dirLen, relativePath, pathLen);
+		if (length < sizeof(pathBuffer))
+			fullPath = pathBuffer;
+		else if (!(fullPath = (char*)xdgMalloc(length+1)))
+			return 0;
+		else
+			xdgJoinMeasured(fullPath, length+1, *item, dirLen, relativePath, pathLen);
+		xdgCount(xdgStatistics.probes, 1);
+		testFile = fopen(fullPath, mode);
+		if (fullPath != pathBuffer)
+			free(fullPath);
+		xdgProbed(dirCounts, relativePath, dirList, item-dirList, testFile != 0);
+		if (testFile)
+			return testFile;
+	}
+	return 0;
+}
+
+/** Open first possible file corresponding to relativePath, see xdgFileOpenUntraced(). */
+static FILE * xdgFileOpen(const char * relativePath, const char * mode, const char * const * dirList,
+	const size_t * dirLengths, const int * dirFds, unsigned long * dirCounts)
+{
+	FILE * result;
+	xdgTrace2(open__entry, relativePath, mode);
+	result = xdgFileOpenUntraced(relativePath, mode, dirList, dirLengths, dirFds, dirCounts);
+	xdgTrace2(open__return, relativePath, result);
+	return result;
+}
+
+/** Open the first existing file corresponding to relativePath for reading.
+  * @param relativePath Path to scan for.
+  * @param dirList <tt>NULL</tt>-terminated list of paths in which to search for relativePath.
+  * @param dirLengths xdgDirectoryLength() of each item in dirList, or NULL to measure them.
+  * @param dirFds List of directory file descriptors parallel to dirList, or NULL.
+  * @param dirCounts Hit and miss counts for each item in dirList, or NULL.
+  * @return A file descriptor, or -1 with errno set if no file could be opened.
+  */
+static int xdgOpenFirst(const char * relativePath, const char * const * dirList, const size_t * dirLengths,
+	const int * dirFds, unsigned long * dirCounts)
+{
+	char pathBuffer[PATH_MAX];
+	char * fullPath;
+	size_t length, dirLen;
+	size_t pathLen = strlen(relativePath);
+	const char * const * item;
+	int fd;
+
+	for (item = dirList; *item; item++)
+	{
+		xdgCount(xdgStatistics.probes, 1);
+#ifdef XDG_HAVE_DIRFDS
+		if (dirFds && dirFds[item-dirList] >= 0)
+			fd = openat(dirFds[item-dirList], xdgRelativeToFd(relativePath), O_RDONLY | O_CLOEXEC);
+		else
+#endif
+		{
+			dirLen = dirLengths ? dirLengths[item-dirList] : xdgDirectoryLength(*item);
+			length = xdgJoinMeasured(pathBuffer, sizeof(pathBuffer), *item, dirLen, relativePath, pathLen);
+			if (length < sizeof(pathBuffer))
+				fullPath = pathBuffer;
+			else if (!(fullPath = (char*)xdgMalloc(length+1)))
+				return -1;
+			else
+				xdgJoinMeasured(fullPath, length+1, *item, dirLen, relativePath, pathLen);
+			fd = open(fullPath, O_RDONLY | O_CLOEXEC);
+			if (fullPath != pathBuffer)
+				free(fullPath);
+		}
+		xdgProbed(dirCounts, relativePath, dirList, item-dirList, fd != -1);
+		if (fd != -1)
+			return fd;
+	}
+	errno = ENOENT;
+	return -1;
+}
+
+/** Open the first existing file corresponding to relativePath in the environment for reading.
+  * Like xdgOpenFirst(), but walking the directories with an iterator.
+  * @param relativePath Path to scan for.
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories to search.
+  * @return A file descriptor, or -1 with errno set if no file could be opened.
+  */
+static int xdgOpenFirstInEnvironment(const char * relativePath, int dirClass)
+{
+	xdgDirectoryIterator it;
+	size_t pathLen = strlen(relativePath);
+	int fd;
+
+	if (!xdgStartDirectories(&it, dirClass))
+		return -1;
+	while (xdgNextCandidate(&it, relativePath, pathLen))
+	{
+		xdgCount(xdgStatistics.probes, 1);
+		fd = open(it.path, O_RDONLY | O_CLOEXEC);
+		xdgProbedCandidate(&it, relativePath, fd != -1);
+		if (fd != -1)
+			return fd;
+	}
+	errno = ENOENT;
+	return -1;
+}
+
+/** Create a directory relative to a directory descriptor.
+ * @param dirFd Descriptor relative paths are resolved against, or -1 for
+ *              the working directory. Must be -1 without mkdirat().
+ */
+static int xdgMkdirAt(int dirFd, const char * path, mode_t mode)
+{
+#ifdef XDG_HAVE_MKDIRAT
+	return mkdirat(dirFd >= 0 ? dirFd : AT_FDCWD, path, mode);
+#else
+	return mkdir(path, mode);
+#endif
+}
+
+/** Create path and all its missing parents, see xdgMakePath().
+ * The deepest existing ancestor is found walking backwards from path
+ * itself, so that every directory that already exists costs nothing
+ * and every missing one a single failed and a single successful mkdir().
+ * @param dirFd Descriptor relative paths are resolved against, or -1 for
+ *              the working directory, see xdgMkdirAt().
+ */
+static int xdgCreatePathAt(int dirFd, const char * path, mode_t mode)
+{
+	size_t length = strlen(path), end, parent;
+	char * tmpPath;
+	int ret;
+
+	if (length == 0 || (length == 1 && path[0] == DIR_SEPARATOR_CHAR))
+		return 0;
+
+	if (!(tmpPath = (char*)xdgMalloc(length+1)))
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	strcpy(tmpPath, path);
+	if (tmpPath[length-1] == DIR_SEPARATOR_CHAR)
+		tmpPath[--length] = '\0';
+
+	/* cut off components until a directory can be created or exists */
+	end = length;
+	while ((ret = xdgMkdirAt(dirFd, tmpPath, mode)) == -1 && errno == ENOENT)
+	{
+		/* skip tmpPath[0] since if it's a seperator we have an absolute path */
+		for (parent = end-1; parent > 0 && tmpPath[parent] != DIR_SEPARATOR_CHAR; --parent) ;
+		if (parent == 0)
+			break;
+		tmpPath[end = parent] = '\0';
+	}
+	/* then put them back one by one, an existing path itself is still an error */
+	while ((ret == 0 || errno == EEXIST) && end < length)
+	{
+		tmpPath[end] = DIR_SEPARATOR_CHAR;
+		end += strlen(tmpPath+end);
+		ret = xdgMkdirAt(dirFd, tmpPath, mode);
+	}
+	free(tmpPath);
+	return ret;
+}
+
+/** Create path and all its missing parents, see xdgMakePath(). */
+static int xdgCreatePath(const char * path, mode_t mode)
+{
+	return xdgCreatePathAt(-1, path, mode);
+}
+
+int xdgMakePath(const char * path, mode_t mode)
+{
+	int ret;
+	xdgTrace2(makepath__entry, path, mode);
+	ret = xdgCreatePath(path, mode);
+	xdgTrace2(makepath__return, path, ret);
+	return ret;
+}
+
+/** Create a path below a home directory, see xdgDataMakePath().
+ * @param homeFd Descriptor of home, or -1 to create the full path.
+ */
+static int xdgCreateHomePath(const char * home, int homeFd, const char * relativePath, mode_t mode)
+{
+	char pathBuffer[PATH_MAX];
+	char * fullPath;
+	size_t length;
+	int ret;
+
+#ifdef XDG_HAVE_MKDIRAT
+	if (homeFd >= 0)
+		return xdgCreatePathAt(homeFd, xdgRelativeToFd(relativePath), mode);
+#endif
+	length = xdgJoinPath(pathBuffer, sizeof(pathBuffer), home, relativePath);
+	if (length < sizeof(pathBuffer))
+		fullPath = pathBuffer;
+	else if (!(fullPath = (char*)xdgMalloc(length+1)))
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	else
+		xdgJoinPath(fullPath, length+1, home, relativePath);
+	ret = xdgCreatePath(fullPath, mode);
+	if (fullPath != pathBuffer)
+		free(fullPath);
+	return ret;
+}
+
+/** Create a path below the home directory of a class.
+ * @param dirClass @c XDG_CLASS_* constant.
+ * @param handle Initialized handle, or NULL to use the environment.
+ */
+static int xdgMakeHomePath(const char * relativePath, mode_t mode, int dirClass, xdgHandle *handle)
+{
+	xdgCachedData *cache;
+	char *home;
+	int ticket, homeFd = -1, ret = -1;
+
+	xdgTrace2(makepath__entry, relativePath, mode);
+	if (handle)
+	{
+		ticket = xdgBeginRead(handle);
+		cache = xdgGetCache(handle);
+		if (!(home = cache->homes[dirClass]))
+			errno = EINVAL;
+		else
+		{
+			if (cache->searchableFds[dirClass])
+				homeFd = cache->searchableFds[dirClass][0];
+			ret = xdgCreateHomePath(home, homeFd, relativePath, mode);
+		}
+		xdgEndRead(handle, ticket);
+	}
+	else if ((home = xdgGetHome(dirClass)))
+	{
+		ret = xdgCreateHomePath(home, -1, relativePath, mode);
+		free(home);
+	}
+	xdgTrace2(makepath__return, relativePath, ret);
+	return ret;
+}
+
+int xdgDataMakePath(const char * relativePath, mode_t mode, xdgHandle *handle)
+{
+	return xdgMakeHomePath(relativePath, mode, XDG_CLASS_DATA, handle);
+}
+
+int xdgConfigMakePath(const char * relativePath, mode_t mode, xdgHandle *handle)
+{
+	return xdgMakeHomePath(relativePath, mode, XDG_CLASS_CONFIG, handle);
+}
+
+int xdgCacheMakePath(const char * relativePath, mode_t mode, xdgHandle *handle)
+{
+	return xdgMakeHomePath(relativePath, mode, XDG_CLASS_CACHE, handle);
+}
+
+int xdgStateMakePath(const char * relativePath, mode_t mode, xdgHandle *handle)
+{
+	return xdgMakeHomePath(relativePath, mode, XDG_CLASS_STATE, handle);
+}
+
+#if defined(XDG_HAVE_INDEX) || defined(XDG_HAVE_LISTINGS)
+/** Make room for more data in a buffer allocated using malloc().
+  * @return TRUE if at least needed bytes are available after used, else FALSE. */
+static int xdgReserve(char **buffer, size_t *capacity, size_t used, size_t needed)
+{
+	char *grown;
+	size_t size;
+
+	if (*capacity-used >= needed) return TRUE;
+	size = MAX(*capacity*2, used+needed);
+	if (!(grown = (char*)xdgRealloc(*buffer, size))) return FALSE;
+	*buffer = grown;
+	*capacity = size;
+	return TRUE;
+}
+#endif
+
+#ifdef XDG_HAVE_INDEX
+/** Directory below the cache home holding index files. */
+static const char IndexDirectory[] = "libxdg-basedir";
+
+/** Get the directory class of a lookup cache key. */
+static int xdgLookupClass(int kind)
+{
+	return kind & ((1 << XDG_CLASS_BITS)-1);
+}
+
+/** Get the probe flags of a lookup cache key. */
+static int xdgLookupFlags(int kind)
+{
+	return kind >> XDG_CLASS_BITS;
+}
+
+/** Copy the search lists of a cache as they are stored in an index file.
+  * Each list is stored as its length in decimal followed by its
+  * directories, all null-terminated.
+  * @param buffer Receives the lists, or NULL to only measure them.
+  * @return The size of the lists. */
+static size_t xdgCopyIndexLists(const xdgCachedData *cache, char *buffer)
+{
+	char ** const *lists = cache->searchable;
+	char number[24];
+	size_t size = 0, length;
+	unsigned int count;
+	int i;
+
+	for (i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		for (count = 0; lists[i][count]; ++count) ;
+		length = sprintf(number, "%u", count)+1;
+		if (buffer)
+			memcpy(buffer+size, number, length);
+		size += length;
+		for (count = 0; lists[i][count]; ++count)
+		{
+			length = strlen(lists[i][count])+1;
+			if (buffer)
+				memcpy(buffer+size, lists[i][count], length);
+			size += length;
+		}
+	}
+	return size;
+}
+
+/** Get the path of the index file for a set of search lists.
+  * Different lists use different files, so that programs run with
+  * different environments do not keep replacing each other's index.
+  * @param lists The search lists, see xdgCopyIndexLists().
+  * @return The length of the path, which is only written if it fits in buffer. */
+static size_t xdgGetIndexPath(char *buffer, size_t size, const xdgCachedData *cache,
+	const char *lists, size_t listsSize)
+{
+	char name[sizeof(IndexDirectory)+16];
+	unsigned int hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < listsSize; ++i)
+		hash = (hash ^ (unsigned char)lists[i]) * 16777619u;
+	sprintf(name, "%s" DIR_SEPARATOR_STR "index-%08x", IndexDirectory, hash);
+	return xdgJoinPath(buffer, size, cache->homes[XDG_CLASS_CACHE], name);
+}
+
+/** Get the path of a subdirectory of a searched directory.
+  * @return The length of the path, which is only written if it fits in buffer. */
+static size_t xdgGetGroupDirectory(char *buffer, size_t size, const char *dir, const char *subdirectory)
+{
+	size_t length;
+
+	if (*subdirectory)
+		return xdgJoinPath(buffer, size, dir, subdirectory);
+	if ((length = strlen(dir)) < size)
+		memcpy(buffer, dir, length+1);
+	return length;
+}
+
+/** Fill in a stamp from the status of a directory. */
+static void xdgFillStamp(xdgIndexStamp *stamp, const struct stat *st, size_t prefixLength)
+{
+	stamp->device = st->st_dev;
+	stamp->inode = st->st_ino;
+	stamp->seconds = (unsigned long long)st->st_mtime;
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC || !defined(HAVE_CONFIG_H)
+	stamp->nanoseconds = st->st_mtim.tv_nsec;
+#else
+	stamp->nanoseconds = 0;
+#endif
+	stamp->prefixLength = prefixLength;
+}
+
+/** Take the stamp of the deepest existing ancestor of a directory.
+  * @return TRUE if successful, FALSE if no ancestor could be examined. */
+static int xdgStampDirectory(const char *path, xdgIndexStamp *stamp)
+{
+	char buffer[PATH_MAX];
+	size_t length = strlen(path);
+	struct stat st;
+
+	if (length >= sizeof(buffer)) return FALSE;
+	memcpy(buffer, path, length+1);
+	while (stat(buffer, &st) == -1)
+	{
+		if ((errno != ENOENT && errno != ENOTDIR) || length <= 1)
+			return FALSE;
+		/* remove the last component, but keep the root */
+		while (length > 0 && buffer[--length] != DIR_SEPARATOR_CHAR) ;
+		if (buffer[length] != DIR_SEPARATOR_CHAR)
+			return FALSE;
+		if (!length)
+			++length;
+		buffer[length] = '\0';
+	}
+	xdgFillStamp(stamp, &st, length);
+	return TRUE;
+}
+
+/** Check whether a directory still has a stamp taken by xdgStampDirectory(). */
+static int xdgCheckStamp(const char *path, const xdgIndexStamp *stamp)
+{
+	char buffer[PATH_MAX];
+	xdgIndexStamp current;
+	struct stat st;
+
+	if (!stamp->prefixLength || stamp->prefixLength > strlen(path))
+		return FALSE;
+	memcpy(buffer, path, stamp->prefixLength);
+	buffer[stamp->prefixLength] = '\0';
+	if (stat(buffer, &st) == -1)
+		return FALSE;
+	xdgFillStamp(&current, &st, stamp->prefixLength);
+	return memcmp(&current, stamp, sizeof(current)) == 0;
+}
+
+/** Unmap the index file of a handle, if any. */
+static void xdgDropIndex(xdgLookupIndex *index)
+{
+	if (index->map)
+		munmap((void*)index->map, ((const xdgIndexHeader*)index->map)->size);
+	free(index->validGroups);
+	xdgZeroMemory(index, sizeof(xdgLookupIndex));
+}
+
+/** Check the stamps of all groups of a mapped index against the file system. */
+static void xdgValidateIndex(xdgLookupIndex *index, const xdgCachedData *cache)
+{
+	const xdgIndexHeader *header = (const xdgIndexHeader*)index->map;
+	const xdgIndexGroup *group;
+	char path[PATH_MAX];
+	char **dirs;
+	unsigned int i, j;
+
+	if (!header) return;
+	for (i = 0; i < header->groupCount; ++i)
+	{
+		group = &index->groups[i];
+		dirs = cache->searchable[group->dirClass];
+		index->validGroups[i] = TRUE;
+		for (j = 0; dirs[j] && index->validGroups[i]; ++j)
+			index->validGroups[i] =
+				xdgGetGroupDirectory(path, sizeof(path), dirs[j], index->strings+group->path) < sizeof(path) &&
+				xdgCheckStamp(path, &index->stamps[group->stamps+j]);
+	}
+}
+
+/** Check that all offsets in a mapped index file are in bounds.
+  * @param dirCounts Number of searched directories of each class.
+  * @return TRUE if the index can be used, else FALSE. */
+static int xdgCheckIndexLayout(const xdgLookupIndex *index, const unsigned int *dirCounts)
+{
+	const xdgIndexHeader *header = (const xdgIndexHeader*)index->map;
+	const xdgIndexGroup *group;
+	const xdgIndexEntry *entry;
+	unsigned int i;
+
+	for (i = 0; i < header->groupCount; ++i)
+	{
+		group = &index->groups[i];
+		if (group->dirClass >= XDG_CLASS_COUNT || group->path >= header->stringsSize ||
+			group->stamps > header->stampCount ||
+			dirCounts[group->dirClass] > header->stampCount-group->stamps)
+			return FALSE;
+	}
+	for (i = 0; i < header->entryCount; ++i)
+	{
+		entry = &index->entries[i];
+		if (entry->group >= header->groupCount ||
+			xdgLookupClass(entry->kind) != (int)index->groups[entry->group].dirClass ||
+			entry->path >= header->stringsSize || !entry->resultLength ||
+			entry->result > header->stringsSize ||
+			entry->resultLength > header->stringsSize-entry->result)
+			return FALSE;
+		/* results are double-null terminated string lists */
+		if (index->strings[entry->result+entry->resultLength-1] ||
+			(entry->resultLength > 1 && index->strings[entry->result+entry->resultLength-2]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/** Map the index file for the search lists of a cache, if there is a valid one.
+  * Any index mapped before is dropped. */
+static void xdgLoadIndex(xdgLookupIndex *index, const xdgCachedData *cache)
+{
+	const xdgIndexHeader *header;
+	char path[PATH_MAX];
+	char *lists;
+	size_t listsSize;
+	unsigned long long offset;
+	unsigned int dirCounts[XDG_CLASS_COUNT];
+	struct stat st;
+	void *map = MAP_FAILED;
+	int fd, valid, i;
+
+	xdgDropIndex(index);
+	listsSize = xdgCopyIndexLists(cache, 0);
+	if (!(lists = (char*)xdgMalloc(listsSize))) return;
+	xdgCopyIndexLists(cache, lists);
+	if (xdgGetIndexPath(path, sizeof(path), cache, lists, listsSize) >= sizeof(path) ||
+		(fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+	{
+		free(lists);
+		return;
+	}
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(xdgIndexHeader) && st.st_size <= (off_t)UINT_MAX)
+		map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		free(lists);
+		return;
+	}
+
+	header = (const xdgIndexHeader*)map;
+	offset = sizeof(xdgIndexHeader) +
+		(unsigned long long)header->stampCount*sizeof(xdgIndexStamp) +
+		(unsigned long long)header->groupCount*sizeof(xdgIndexGroup) +
+		(unsigned long long)header->entryCount*sizeof(xdgIndexEntry);
+	valid = header->magic == XDG_INDEX_MAGIC && header->version == XDG_INDEX_VERSION &&
+		header->size == (unsigned long long)st.st_size && offset <= header->size &&
+		header->stringsSize == header->size-offset && header->stringsSize &&
+		header->listsSize == listsSize && listsSize <= header->stringsSize &&
+		memcmp((const char*)map+offset, lists, listsSize) == 0 &&
+		((const char*)map)[header->size-1] == '\0';
+	free(lists);
+	if (valid)
+	{
+		index->map = (const char*)map;
+		index->stamps = (const xdgIndexStamp*)(index->map+sizeof(xdgIndexHeader));
+		index->groups = (const xdgIndexGroup*)(index->stamps+header->stampCount);
+		index->entries = (const xdgIndexEntry*)(index->groups+header->groupCount);
+		index->strings = index->map+offset;
+		for (i = 0; i < XDG_CLASS_COUNT; ++i)
+			for (dirCounts[i] = 0; cache->searchable[i][dirCounts[i]]; ++dirCounts[i]) ;
+		valid = xdgCheckIndexLayout(index, dirCounts) &&
+			(index->validGroups = (unsigned char*)xdgMalloc(header->groupCount+1));
+	}
+	if (!valid)
+	{
+		xdgZeroMemory(index, sizeof(xdgLookupIndex));
+		munmap(map, st.st_size);
+		return;
+	}
+	xdgValidateIndex(index, cache);
+}
+
+/** Look up a find result in a mapped index file.
+  * @param buffer Receives a copy of the result if it fits.
+  * @param size Size of buffer.
+  * @return The size of the indexed result, or 0 if there is no valid entry. */
+static size_t xdgGetIndexedLookup(const xdgLookupIndex *index, const char * relativePath, int kind,
+	char * buffer, size_t size)
+{
+	const xdgIndexHeader *header = (const xdgIndexHeader*)index->map;
+	const xdgIndexEntry *entry, *end = index->entries+header->entryCount;
+	unsigned int hash = xdgHashLookup(relativePath, kind);
+	unsigned int low = 0, high = header->entryCount, middle;
+
+	/* find the first entry with the hash */
+	while (low < high)
+	{
+		middle = low + (high-low)/2;
+		if (index->entries[middle].hash < hash)
+			low = middle+1;
+		else
+			high = middle;
+	}
+	for (entry = index->entries+low; entry < end && entry->hash == hash; ++entry)
+	{
+		if (entry->kind != kind || strcmp(index->strings+entry->path, relativePath) != 0)
+			continue;
+		if (!index->validGroups[entry->group])
+			return 0;
+		if (entry->resultLength <= size)
+			memcpy(buffer, index->strings+entry->result, entry->resultLength);
+		return entry->resultLength;
+	}
+	return 0;
+}
+
+/** Lookup to be written to an index file. */
+typedef struct _xdgIndexKey
+{
+	const char * path;
+	int kind;
+	/** Length of the subdirectory part of path, which selects the group. */
+	size_t dirLength;
+} xdgIndexKey;
+
+/** Order index keys by group. */
+static int xdgCompareIndexKeys(const void *a, const void *b)
+{
+	const xdgIndexKey *x = (const xdgIndexKey*)a, *y = (const xdgIndexKey*)b;
+	int diff;
+
+	if ((diff = xdgLookupClass(x->kind) - xdgLookupClass(y->kind)))
+		return diff;
+	if ((diff = memcmp(x->path, y->path, x->dirLength < y->dirLength ? x->dirLength : y->dirLength)))
+		return diff;
+	return x->dirLength < y->dirLength ? -1 : x->dirLength > y->dirLength;
+}
+
+/** Order index entries by hash. */
+static int xdgCompareIndexEntries(const void *a, const void *b)
+{
+	const xdgIndexEntry *x = (const xdgIndexEntry*)a, *y = (const xdgIndexEntry*)b;
+	return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+/** Add a lookup to a list of index keys. */
+static void xdgAddIndexKey(xdgIndexKey *key, const char *path, int kind)
+{
+	const char *separator = strrchr(path, DIR_SEPARATOR_CHAR);
+	key->path = path;
+	key->kind = kind;
+	key->dirLength = separator ? separator-path : 0;
+}
+
+/** Collect the lookups of a handle that belong in its index file.
+  * These are the entries of the lookup cache and of the mapped index,
+  * limited to the most recent @c XDG_LOOKUP_CACHE_MAX_ENTRIES.
+  * @param count Receives the number of keys.
+  * @return The keys, allocated using malloc(), or NULL on failure. */
+static xdgIndexKey * xdgCollectIndexKeys(xdgHandleData *data, size_t *count)
+{
+	const xdgIndexHeader *header = (const xdgIndexHeader*)data->index.map;
+	const xdgIndexEntry *entry;
+	xdgLookupEntry *lookup;
+	xdgIndexKey *keys;
+	size_t size = data->lookups.entryCount + (header ? header->entryCount : 0);
+	unsigned int i;
+
+	if (!(keys = (xdgIndexKey*)xdgMalloc(sizeof(xdgIndexKey)*(size+1)))) return 0;
+	*count = 0;
+	/* Note: looking up indexed keys may remove stale cache entries, */
+	/* so it is done before collecting those. */
+	for (i = 0; header && i < header->entryCount; ++i)
+	{
+		entry = &data->index.entries[i];
+		if (!xdgGetCachedLookup(&data->lookups, data->index.strings+entry->path, entry->kind, 0, 0))
+			xdgAddIndexKey(&keys[(*count)++], data->index.strings+entry->path, entry->kind);
+	}
+	for (i = 0; i < data->lookups.bucketCount; ++i)
+		for (lookup = data->lookups.buckets[i]; lookup; lookup = lookup->next)
+			xdgAddIndexKey(&keys[(*count)++], lookup->data, lookup->kind);
+	if (*count > XDG_LOOKUP_CACHE_MAX_ENTRIES)
+	{
+		memmove(keys, keys+*count-XDG_LOOKUP_CACHE_MAX_ENTRIES, sizeof(xdgIndexKey)*XDG_LOOKUP_CACHE_MAX_ENTRIES);
+		*count = XDG_LOOKUP_CACHE_MAX_ENTRIES;
+	}
+	return keys;
+}
+
+/** Write all of a buffer to a file descriptor.
+  * @return TRUE if successful, else FALSE. */
+static int xdgWriteAll(int fd, const void *buffer, size_t size)
+{
+	const char *ptr = (const char*)buffer;
+	ssize_t written;
+
+	while (size)
+	{
+		if ((written = write(fd, ptr, size)) == -1)
+		{
+			if (errno == EINTR) continue;
+			return FALSE;
+		}
+		ptr += written;
+		size -= written;
+	}
+	return TRUE;
+}
+
+/** Replace an index file.
+  * The file is written under a temporary name and renamed, so that
+  * mapped copies never change and readers never see partial files.
+  * @return TRUE if successful, else FALSE. */
+static int xdgWriteIndexFile(const char *path, const xdgIndexHeader *header, const xdgIndexStamp *stamps,
+	const xdgIndexGroup *groups, const xdgIndexEntry *entries, const char *strings)
+{
+	char tmpPath[PATH_MAX+8];
+	int fd, ok;
+
+	sprintf(tmpPath, "%s.XXXXXX", path);
+	if ((fd = mkstemp(tmpPath)) == -1)
+		return FALSE;
+	ok = xdgWriteAll(fd, header, sizeof(xdgIndexHeader)) &&
+		xdgWriteAll(fd, stamps, sizeof(xdgIndexStamp)*header->stampCount) &&
+		xdgWriteAll(fd, groups, sizeof(xdgIndexGroup)*header->groupCount) &&
+		xdgWriteAll(fd, entries, sizeof(xdgIndexEntry)*header->entryCount) &&
+		xdgWriteAll(fd, strings, header->stringsSize);
+	if (close(fd) == -1)
+		ok = FALSE;
+	if (ok && rename(tmpPath, path) == 0)
+		return TRUE;
+	unlink(tmpPath);
+	return FALSE;
+}
+
+/** Probe the lookups to be written to an index file.
+  * Every lookup is probed again after stamping the directories it
+  * depends on, so that a change made after the lookup was cached cannot
+  * produce an index entry that looks valid. Groups with recently changed
+  * directories are left out, see @c XDG_INDEX_SETTLE_TIME.
+  * @param keys Lookups sorted with xdgCompareIndexKeys().
+  * @param header Receives the counts and sizes of the arrays filled in.
+  * @param stamps Receives up to keyCount stamps per searched directory.
+  * @param groups Receives up to keyCount groups.
+  * @param entries Receives up to keyCount entries.
+  * @param strings String area holding the search lists, grown as needed.
+  * @param capacity Allocated size of the string area.
+  * @return TRUE if successful, else FALSE. */
+static int xdgBuildIndex(const xdgCachedData *cache, const xdgIndexKey *keys, size_t keyCount,
+	xdgIndexHeader *header, xdgIndexStamp *stamps, xdgIndexGroup *groups, xdgIndexEntry *entries,
+	char **strings, size_t *capacity)
+{
+	xdgIndexGroup *group;
+	xdgIndexEntry *entry;
+	char path[PATH_MAX];
+	char **dirs;
+	const size_t *lengths;
+	const int *fds;
+	size_t used = header->listsSize, length, i, j, k, end;
+	long long settled = (long long)time(0) - XDG_INDEX_SETTLE_TIME;
+
+	for (i = 0; i < keyCount; i = end)
+	{
+		for (end = i+1; end < keyCount && xdgCompareIndexKeys(&keys[i], &keys[end]) == 0; ++end) ;
+		group = &groups[header->groupCount];
+		group->dirClass = xdgLookupClass(keys[i].kind);
+		group->stamps = header->stampCount;
+		group->path = used;
+		dirs = cache->searchable[group->dirClass];
+		lengths = cache->searchableLengths[group->dirClass];
+		fds = cache->searchableFds[group->dirClass];
+		if (!xdgReserve(strings, capacity, used, keys[i].dirLength+1))
+			return FALSE;
+		memcpy(*strings+used, keys[i].path, keys[i].dirLength);
+		(*strings)[used+keys[i].dirLength] = '\0';
+
+		/* stamp before probing, so that later changes invalidate the results */
+		for (j = 0; dirs[j]; ++j)
+			if (xdgGetGroupDirectory(path, sizeof(path), dirs[j], *strings+group->path) >= sizeof(path) ||
+				!xdgStampDirectory(path, &stamps[header->stampCount+j]) ||
+				(long long)stamps[header->stampCount+j].seconds > settled)
+				break;
+		if (dirs[j])
+			continue;
+		used += keys[i].dirLength+1;
+		header->stampCount += j;
+
+		for (k = i; k < end; ++k)
+		{
+			entry = &entries[header->entryCount];
+			entry->hash = xdgHashLookup(keys[k].path, keys[k].kind);
+			entry->kind = keys[k].kind;
+			entry->group = header->groupCount;
+			length = strlen(keys[k].path)+1;
+			if (!xdgReserve(strings, capacity, used, length+PATH_MAX))
+				return FALSE;
+			entry->path = used;
+			memcpy(*strings+used, keys[k].path, length);
+			entry->result = used+length;
+			while ((entry->resultLength = xdgFindExisting(keys[k].path, (const char * const *)dirs, lengths, fds, 0, 0,
+				xdgLookupFlags(keys[k].kind), *strings+entry->result, *capacity-entry->result, 0)) > *capacity-entry->result)
+			{
+				if (!xdgReserve(strings, capacity, entry->result, entry->resultLength))
+					return FALSE;
+			}
+			/* lookups that fail now are left for the next run */
+			if (!entry->resultLength)
+				continue;
+			used = entry->result+entry->resultLength;
+			++header->entryCount;
+		}
+		++header->groupCount;
+	}
+	if (used > UINT_MAX/2)
+	{
+		errno = EFBIG;
+		return FALSE;
+	}
+	header->stringsSize = used;
+	header->size = sizeof(xdgIndexHeader) + sizeof(xdgIndexStamp)*header->stampCount +
+		sizeof(xdgIndexGroup)*header->groupCount + sizeof(xdgIndexEntry)*header->entryCount + used;
+	qsort(entries, header->entryCount, sizeof(xdgIndexEntry), xdgCompareIndexEntries);
+	return TRUE;
+}
+
+/** Write the index file of a handle, see xdgBuildIndex().
+  * @return TRUE if successful, else FALSE with errno set. */
+static int xdgWriteIndex(xdgHandleData *data, const xdgCachedData *cache)
+{
+	xdgIndexHeader header;
+	xdgIndexKey *keys;
+	xdgIndexStamp *stamps;
+	xdgIndexGroup *groups;
+	xdgIndexEntry *entries;
+	char path[PATH_MAX];
+	char *strings, *separator;
+	size_t keyCount, dirCount, capacity;
+	unsigned int count;
+	int ok = FALSE, i;
+
+	if (!(keys = xdgCollectIndexKeys(data, &keyCount))) return FALSE;
+	qsort(keys, keyCount, sizeof(xdgIndexKey), xdgCompareIndexKeys);
+	for (dirCount = i = 0; i < XDG_CLASS_COUNT; ++i)
+	{
+		for (count = 0; cache->searchable[i][count]; ++count) ;
+		dirCount = MAX(dirCount, count);
+	}
+	xdgZeroMemory(&header, sizeof(header));
+	header.magic = XDG_INDEX_MAGIC;
+	header.version = XDG_INDEX_VERSION;
+	header.listsSize = capacity = xdgCopyIndexLists(cache, 0);
+	stamps = (xdgIndexStamp*)xdgMalloc(sizeof(xdgIndexStamp)*(keyCount*dirCount+1));
+	groups = (xdgIndexGroup*)xdgMalloc(sizeof(xdgIndexGroup)*(keyCount+1));
+	entries = (xdgIndexEntry*)xdgMalloc(sizeof(xdgIndexEntry)*(keyCount+1));
+	strings = (char*)xdgMalloc(capacity);
+	if (stamps && groups && entries && strings)
+	{
+		xdgCopyIndexLists(cache, strings);
+		if (xdgGetIndexPath(path, sizeof(path), cache, strings, header.listsSize) >= sizeof(path))
+			errno = ENAMETOOLONG;
+		else
+		{
+			/* create the directory before taking stamps, which it may change */
+			separator = strrchr(path, DIR_SEPARATOR_CHAR);
+			*separator = '\0';
+			ok = xdgCreatePath(path, 0700) == 0 || errno == EEXIST;
+			*separator = DIR_SEPARATOR_CHAR;
+		}
+		if (ok && xdgBuildIndex(cache, keys, keyCount, &header, stamps, groups, entries, &strings, &capacity))
+			ok = xdgWriteIndexFile(path, &header, stamps, groups, entries, strings);
+		else
+			ok = FALSE;
+	}
+	if (ok)
+		data->index.dirty = FALSE;
+	free(keys);
+	free(stamps);
+	free(groups);
+	free(entries);
+	free(strings);
+	return ok;
+}
+#else
+static void xdgDropIndex(xdgLookupIndex *index)
+{
+}
+static void xdgValidateIndex(xdgLookupIndex *index, const xdgCachedData *cache)
+{
+}
+static void xdgLoadIndex(xdgLookupIndex *index, const xdgCachedData *cache)
+{
+}
+static size_t xdgGetIndexedLookup(const xdgLookupIndex *index, const char * relativePath, int kind,
+	char * buffer, size_t size)
+{
+	return 0;
+}
+static int xdgWriteIndex(xdgHandleData *data, const xdgCachedData *cache)
+{
+	errno = ENOSYS;
+	return FALSE;
+}
+#endif
+
+int xdgSaveIndex(xdgHandle *handle)
+{
+	xdgHandleData *data = xdgGetHandleData(handle);
+	if (!(data->flags & XDG_HANDLE_INDEX))
+	{
+		errno = EINVAL;
+		return FALSE;
+	}
+	return !data->index.dirty || xdgWriteIndex(data, data->cache);
+}
+
+const char * xdgHome(xdgDirectoryClass dirClass, xdgHandle *handle)
+{
+	if (!xdgCheckClass(dirClass))
+		return NULL;
+	if (handle)
+		return xdgGetCache(handle)->homes[dirClass];
+	else
+		return xdgGetHome(dirClass);
+}
+const char * const * xdgSearchableDirectories(xdgDirectoryClass dirClass, xdgHandle *handle)
+{
+	if (!xdgCheckClass(dirClass))
+		return NULL;
+	if (handle)
+		return (const char * const *)xdgGetCache(handle)->searchable[dirClass];
+	else
+		return (const char * const *)xdgGetDirectoryList(dirClass, TRUE);
+}
+const char * xdgDataHome(xdgHandle *handle)
+{
+	return xdgHome(XDG_DATA, handle);
+}
+const char * xdgConfigHome(xdgHandle *handle)
+{
+	return xdgHome(XDG_CONFIG, handle);
+}
+const char * const * xdgDataDirectories(xdgHandle *handle)
+{
+	if (handle)
+		return (const char * const *)&(xdgGetCache(handle)->searchable[XDG_CLASS_DATA][1]);
+	else
+		return (const char * const *)xdgGetDirectoryList(XDG_CLASS_DATA, FALSE);
+}
+const char * const * xdgSearchableDataDirectories(xdgHandle *handle)
+{
+	return xdgSearchableDirectories(XDG_DATA, handle);
+}
+const char * const * xdgConfigDirectories(xdgHandle *handle)
+{
+	if (handle)
+		return (const char * const *)&(xdgGetCache(handle)->searchable[XDG_CLASS_CONFIG][1]);
+	else
+		return (const char * const *)xdgGetDirectoryList(XDG_CLASS_CONFIG, FALSE);
+}
+const char * const * xdgSearchableConfigDirectories(xdgHandle *handle)
+{
+	return xdgSearchableDirectories(XDG_CONFIG, handle);
+}
+const char * xdgCacheHome(xdgHandle *handle)
+{
+	return xdgHome(XDG_CACHE, handle);
+}
+const char * xdgStateHome(xdgHandle *handle)
+{
+	return xdgHome(XDG_STATE, handle);
+}
+const char * xdgRuntimeDirectory(xdgHandle *handle)
+{
+	return xdgHome(XDG_RUNTIME, handle);
+}
+char * xdgDataFind(const char * relativePath, xdgHandle *handle)
+{
+	return xdgDataFindEx(relativePath, XDG_FIND_READABLE, handle);
+}
+char * xdgConfigFind(const char * relativePath, xdgHandle *handle)
+{
+	return xdgConfigFindEx(relativePath, XDG_FIND_READABLE, handle);
+}
+#ifdef XDG_HAVE_LISTINGS
+/** Find a name in a hash set of names.
+  * @param slots Hash set of offsets of names in strings, 0 for empty
+  * 	slots, with at least one empty slot.
+  * @param slotCount Number of slots, a power of two.
+  * @param strings Names, each preceded by one byte that is not part of the name.
+  * @param name Name to look for.
+  * @return The slot holding the name, or the empty slot where it belongs.
+  */
+static unsigned int xdgFindNameSlot(const unsigned int * slots, unsigned int slotCount,
+	const char * strings, const char * name)
+{
+	unsigned int slot;
+
+	for (slot = xdgHashLookup(name, 0) & (slotCount-1); slots[slot]; slot = (slot+1) & (slotCount-1))
+		if (strcmp(strings+slots[slot], name) == 0)
+			break;
+	return slot;
+}
+
+/** Work out what is known about a lookup from the type of a listed name.
+  * Listings cannot tell whether a file is readable, so only lookups
+  * asking for existence alone can be answered without probing. Links and
+  * names of unknown type are always probed, as a link may dangle.
+  * @param type @c XDG_ENTRY_* constant.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @return An @c XDG_HINT_* constant.
+  */
+static int xdgHintForEntry(int type, int flags)
+{
+	if ((flags & XDG_FIND_FOPEN) || type == XDG_ENTRY_UNKNOWN)
+		return XDG_HINT_PROBE;
+	if ((flags & XDG_FIND_REGULAR) && type == XDG_ENTRY_OTHER)
+		return XDG_HINT_ABSENT;
+	if ((flags & XDG_FIND_EXISTS) && (!(flags & XDG_FIND_REGULAR) || type == XDG_ENTRY_REGULAR))
+		return XDG_HINT_FOUND;
+	return XDG_HINT_PROBE;
+}
+
+/** Get the @c XDG_ENTRY_* type of a directory entry. */
+static char xdgEntryType(const struct dirent * entry)
+{
+#ifdef DT_UNKNOWN
+	if (entry->d_type == DT_REG)
+		return XDG_ENTRY_REGULAR;
+	if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+		return XDG_ENTRY_OTHER;
+#endif
+	return XDG_ENTRY_UNKNOWN;
+}
+
+/** Read a subdirectory of a searchable directory into a new listing.
+  * The entries are collected in a temporary buffer and copied into
+  * the listing once their number is known.
+  * @param dir Searchable directory.
+  * @param subdirectory Relative path of the subdirectory, empty for dir itself.
+  * @return The listing, allocated using malloc(), or NULL if out of memory.
+  */
+static xdgListing * xdgReadListing(const char * dir, const char * subdirectory)
+{
+	char path[PATH_MAX];
+	char * entries = 0;
+	size_t capacity = 0, used = 0, count = 0, length, offset;
+	size_t subLength = strlen(subdirectory);
+	unsigned int slotCount, slot;
+	int status = XDG_LISTING_READ;
+	xdgListing * listing;
+	struct dirent * entry;
+	DIR * handle = 0;
+
+	if (*subdirectory)
+		length = xdgJoinPath(path, sizeof(path), dir, subdirectory);
+	else if ((length = strlen(dir)) < sizeof(path))
+		memcpy(path, dir, length+1);
+	if (length >= sizeof(path))
+		status = XDG_LISTING_UNREADABLE;
+	else if (!(handle = opendir(path)))
+		status = errno == ENOENT || errno == ENOTDIR ? XDG_LISTING_MISSING : XDG_LISTING_UNREADABLE;
+	else
+	{
+		while ((errno = 0, entry = readdir(handle)))
+		{
+			length = strlen(entry->d_name)+1;
+			if (!xdgReserve(&entries, &capacity, used, length+1))
+				break;
+			entries[used] = xdgEntryType(entry);
+			memcpy(entries+used+1, entry->d_name, length);
+			used += length+1;
+			++count;
+		}
+		if (entry || errno)
+			status = XDG_LISTING_UNREADABLE;
+		closedir(handle);
+	}
+	if (status != XDG_LISTING_READ)
+		used = count = 0;
+
+	/* at most half of the slots are used, so every probe sequence ends */
+	for (slotCount = 1; slotCount < count*2; slotCount <<= 1) ;
+	if (!(listing = (xdgListing*)xdgMalloc(sizeof(xdgListing) + sizeof(unsigned int)*slotCount + used + subLength+1)))
+	{
+		free(entries);
+		return 0;
+	}
+	listing->status = status;
+	listing->slotCount = slotCount;
+	listing->slots = (unsigned int*)(listing+1);
+	listing->entries = (char*)(listing->slots+slotCount);
+	listing->subdirectory = listing->entries+used;
+	xdgZeroMemory(listing->slots, sizeof(unsigned int)*slotCount);
+	if (used)
+		memcpy(listing->entries, entries, used);
+	memcpy(listing->subdirectory, subdirectory, subLength+1);
+	free(entries);
+	for (offset = 1; offset < used; offset += strlen(listing->entries+offset)+2)
+	{
+		slot = xdgFindNameSlot(listing->slots, slotCount, listing->entries, listing->entries+offset);
+		listing->slots[slot] = offset;
+	}
+	return listing;
+}
+
+/** Look up a name in a listing.
+  * @return The @c XDG_ENTRY_* type of the name, or -1 if it is not listed. */
+static int xdgFindListed(const xdgListing * listing, const char * name)
+{
+	unsigned int slot = xdgFindNameSlot(listing->slots, listing->slotCount, listing->entries, name);
+	return listing->slots[slot] ? listing->entries[listing->slots[slot]-1] : -1;
+}
+
+/** Get the listing of a subdirectory of a searchable directory, reading it if necessary.
+  * Stale listings met on the way are removed.
+  * @param ttl Lifetime of a new listing in milliseconds, 0 if unlimited.
+  * @param dirClass @c XDG_CLASS_* constant of the searchable directory.
+  * @param dirIndex Index of the searchable directory in its list.
+  * @param dir The searchable directory.
+  * @param subdirectory Relative path of the subdirectory, empty for dir itself.
+  * @return The listing, or NULL if out of memory.
+  */
+static const xdgListing * xdgGetListing(xdgListingCache *listings, unsigned int ttl, int dirClass,
+	unsigned int dirIndex, const char * dir, const char * subdirectory)
+{
+	xdgListing **link, *listing;
+	unsigned int hash = xdgHashLookup(subdirectory, (int)(dirIndex << XDG_CLASS_BITS) | dirClass);
+	unsigned long long now = 0;
+
+	if (!listings->buckets)
+	{
+		if (!(listings->buckets = (xdgListing**)xdgMalloc(sizeof(xdgListing*)*XDG_LISTING_CACHE_BUCKETS)))
+			return 0;
+		xdgZeroMemory(listings->buckets, sizeof(xdgListing*)*XDG_LISTING_CACHE_BUCKETS);
+	}
+	for (link = &listings->buckets[hash%XDG_LISTING_CACHE_BUCKETS]; (listing = *link); )
+	{
+		if (listing->expires && listing->expires <= (now ? now : (now = xdgNow())))
+		{
+			*link = listing->next;
+			free(listing);
+			--listings->entryCount;
+			continue;
+		}
+		if (listing->hash == hash && listing->dirClass == dirClass && listing->dirIndex == dirIndex &&
+			strcmp(listing->subdirectory, subdirectory) == 0)
+			return listing;
+		link = &listing->next;
+	}
+
+	if (listings->entryCount >= XDG_LISTING_CACHE_MAX_ENTRIES)
+		xdgFlushListings(listings);
+	if (!(listing = xdgReadListing(dir, subdirectory)))
+		return 0;
+	listing->hash = hash;
+	listing->dirClass = dirClass;
+	listing->dirIndex = dirIndex;
+	listing->expires = ttl ? xdgNow()+ttl : 0;
+	listing->next = listings->buckets[hash%XDG_LISTING_CACHE_BUCKETS];
+	listings->buckets[hash%XDG_LISTING_CACHE_BUCKETS] = listing;
+	++listings->entryCount;
+	return listing;
+}
+
+/** Work out from directory listings what a lookup would find in each directory.
+  * Names that are not listed cannot be found, see xdgHintForEntry() for
+  * those that are.
+  * @param data State of the handle.
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories.
+  * @param dirList <tt>NULL</tt>-terminated list of directory paths of that class.
+  * @param relativePath Relative path to search for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @param hints Receives an @c XDG_HINT_* constant for each item in dirList.
+  * @return TRUE if hints were filled in, FALSE if the lookup has to probe all directories.
+  */
+static int xdgGetHints(xdgHandleData *data, int dirClass, char ** dirList, const char * relativePath,
+	int flags, signed char * hints)
+{
+	const char * name = strrchr(relativePath, DIR_SEPARATOR_CHAR);
+	char subdirectory[PATH_MAX];
+	const xdgListing * listing;
+	size_t subLength = name ? (size_t)(name-relativePath) : 0;
+	size_t i;
+	int type;
+
+	name = name ? name+1 : relativePath;
+	if (!*name || subLength >= sizeof(subdirectory))
+		return FALSE;
+	memcpy(subdirectory, relativePath, subLength);
+	subdirectory[subLength] = '\0';
+	for (i = 0; dirList[i]; ++i)
+	{
+		if (i >= XDG_LISTING_MAX_DIRS)
+			return FALSE;
+		listing = xdgGetListing(&data->listings, data->lookups.ttl, dirClass, i, dirList[i], subdirectory);
+		if (!listing || listing->status == XDG_LISTING_UNREADABLE)
+			hints[i] = XDG_HINT_PROBE;
+		else if (listing->status == XDG_LISTING_MISSING || (type = xdgFindListed(listing, name)) == -1)
+			hints[i] = XDG_HINT_ABSENT;
+		else
+			hints[i] = xdgHintForEntry(type, flags);
+	}
+	return TRUE;
+}
+#else
+static int xdgGetHints(xdgHandleData *data, int dirClass, char ** dirList, const char * relativePath,
+	int flags, signed char * hints)
+{
+	return FALSE;
+}
+#endif
+
+/** Find all existing files corresponding to relativePath in a directory class of a handle.
+  * Uses the lookup cache of the handle if it has one.
+  * @param relativePath Relative path to search for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories to search.
+  * @param buffer Receives the result, see xdgFindExisting().
+  * @param size Size of buffer.
+  * @param grown See xdgFindExisting().
+  * @param handle Initialized handle.
+  * @return See xdgFindExisting().
+  */
+static size_t xdgFindInHandle(const char * relativePath, int flags, int dirClass,
+	char * buffer, size_t size, char ** grown, xdgHandle *handle)
+{
+	xdgHandleData *data = xdgGetHandleData(handle);
+	xdgCachedData *cache;
+	int useLookups = data->flags & (XDG_HANDLE_LOOKUP_CACHE | XDG_HANDLE_WATCH | XDG_HANDLE_INDEX);
+	int kind = xdgLookupKind(dirClass, flags);
+	int ticket, useHints;
+	signed char hints[XDG_LISTING_MAX_DIRS];
+	char ** dirs;
+	size_t result;
+
+	if (useLookups && (result = xdgGetCachedLookup(&data->lookups, relativePath, kind, buffer, size)))
+	{
+		xdgCount(xdgStatistics.lookupCacheHits, 1);
+		/* copying a cached result again probes nothing */
+		if (result > size && grown)
+		{
+			if (!xdgGrowResult(&buffer, &size, 0, result, grown))
+				return 0;
+			xdgGetCachedLookup(&data->lookups, relativePath, kind, buffer, size);
+		}
+		return result;
+	}
+	if (data->index.map && (result = xdgGetIndexedLookup(&data->index, relativePath, kind, buffer, size)))
+	{
+		xdgCount(xdgStatistics.lookupCacheHits, 1);
+		if (result > size && grown)
+		{
+			if (!xdgGrowResult(&buffer, &size, 0, result, grown))
+				return 0;
+			xdgGetIndexedLookup(&data->index, relativePath, kind, buffer, size);
+		}
+		if (result <= size)
+			xdgStoreLookup(&data->lookups, relativePath, kind, buffer);
+		return result;
+	}
+	if (useLookups)
+		xdgCount(xdgStatistics.lookupCacheMisses, 1);
+	ticket = xdgBeginRead(handle);
+	cache = xdgGetCache(handle);
+	dirs = cache->searchable[dirClass];
+	/* watch before probing so that no change can slip in unnoticed */
+	if (useLookups && data->watchFd >= 0)
+		xdgWatchDirectories(data->watchFd, &data->watches, dirs, relativePath);
+	useHints = (data->flags & XDG_HANDLE_LISTINGS) && xdgGetHints(data, dirClass, dirs, relativePath, flags, hints);
+	result = xdgFindExisting(relativePath, (const char * const *)dirs, cache->searchableLengths[dirClass],
+		cache->searchableFds[dirClass], cache->searchableCounts[dirClass], useHints ? hints : 0, flags,
+		buffer, size, grown);
+	xdgEndRead(handle, ticket);
+	/* a result moved to the heap always fits */
+	if (grown && *grown)
+		buffer = *grown;
+	else if (result > size)
+		return result;
+	if (useLookups && result)
+	{
+		xdgStoreLookup(&data->lookups, relativePath, kind, buffer);
+		if (data->flags & XDG_HANDLE_INDEX)
+			data->index.dirty = 1;
+	}
+	return result;
+}
+
+/** Find all existing files corresponding to relativePath in the environment.
+  * Like xdgFindExisting(), but walking the directories with an iterator,
+  * so that nothing is allocated.
+  * @param relativePath Relative path to search for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories to search.
+  * @param buffer Receives the result, see xdgFindExisting().
+  * @param size Size of buffer.
+  * @param grown See xdgFindExisting().
+  * @return See xdgFindExisting().
+  */
+static size_t xdgFindInEnvironment(const char * relativePath, int flags, int dirClass,
+	char * buffer, size_t size, char ** grown)
+{
+	xdgDirectoryIterator it;
+	size_t pathLen = strlen(relativePath);
+	size_t used = 0, length;
+	int found;
+
+	if (!xdgStartDirectories(&it, dirClass))
+		return 0;
+	xdgTrace2(find__entry, relativePath, flags);
+	while ((length = xdgNextCandidate(&it, relativePath, pathLen)))
+	{
+		found = xdgProbeFile(it.path, flags);
+		xdgProbedCandidate(&it, relativePath, found);
+		if (!found)
+			continue;
+		if (used+length+1 >= size && grown && !xdgGrowResult(&buffer, &size, used, length+2, grown))
+			return 0;
+		if (used+length+1 < size)
+			memcpy(buffer+used, it.path, length+1);
+		used += length+1;
+		if (flags & XDG_FIND_FIRST)
+			break;
+	}
+	if (used < size)
+		buffer[used] = 0;
+	xdgTrace2(find__return, relativePath, used+1);
+	return used+1;
+}
+
+/** Find all existing files corresponding to relativePath in a directory class.
+  * @param relativePath Relative path to search for.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories to search.
+  * @param buffer Receives the result, see xdgFindExisting().
+  * @param size Size of buffer.
+  * @param grown See xdgFindExisting().
+  * @param handle Initialized handle, or NULL to use the environment.
+  * @return See xdgFindExisting().
+  */
+static size_t xdgFindInto(const char * relativePath, int flags, int dirClass,
+	char * buffer, size_t size, char ** grown, xdgHandle *handle)
+{
+	xdgCountLookups(dirClass, 1);
+	if (handle)
+		return xdgFindInHandle(relativePath, flags, dirClass, buffer, size, grown, handle);
+	return xdgFindInEnvironment(relativePath, flags, dirClass, buffer, size, grown);
+}
+
+/** Find all existing files corresponding to relativePath in a directory class.
+  * The result is collected on the stack and copied into a single
+  * allocation of the right size. Larger results are moved to the heap
+  * as they are found, so that no directory is probed twice.
+  * @return See xdgFindExisting(), allocated using malloc().
+  */
+static char * xdgFindAllocated(const char * relativePath, int flags, int dirClass, xdgHandle *handle)
+{
+	char stackBuffer[PATH_MAX];
+	char * grown = 0;
+	char * result;
+	size_t length;
+
+	length = xdgFindInto(relativePath, flags, dirClass, stackBuffer, sizeof(stackBuffer), &grown, handle);
+	if (!length)
+	{
+		free(grown);
+		return 0;
+	}
+	if (grown)
+		return (result = (char*)xdgRealloc(grown, length)) ? result : grown;
+	if ((result = (char*)xdgMalloc(length)))
+		memcpy(result, stackBuffer, length);
+	return result;
+}
+
+/** Open the first file corresponding to relativePath in a directory class of a handle.
+  * @param relativePath Relative path to search for.
+  * @param mode Mode with which to attempt to open files (see fopen modes).
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories to search.
+  * @param handle Initialized handle.
+  * @return See xdgFileOpen().
+  */
+static FILE * xdgOpenInHandle(const char * relativePath, const char * mode, int dirClass, xdgHandle *handle)
+{
+	int ticket = xdgBeginRead(handle);
+	xdgCachedData *cache = xdgGetCache(handle);
+	FILE * result;
+
+	result = xdgFileOpen(relativePath, mode, (const char * const *)cache->searchable[dirClass],
+		cache->searchableLengths[dirClass], cache->searchableFds[dirClass], cache->searchableCounts[dirClass]);
+	xdgEndRead(handle, ticket);
+	return result;
+}
+
+/** Open the first file corresponding to relativePath in the environment.
+  * Like xdgFileOpen(), but walking the directories with an iterator.
+  * @param relativePath Relative path to search for.
+  * @param mode Mode with which to attempt to open files (see fopen modes).
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories to search.
+  * @return See xdgFileOpen().
+  */
+static FILE * xdgOpenInEnvironment(const char * relativePath, const char * mode, int dirClass)
+{
+	xdgDirectoryIterator it;
+	size_t pathLen = strlen(relativePath);
+	FILE * result = 0;
+
+	if (!xdgStartDirectories(&it, dirClass))
+		return 0;
+	xdgTrace2(open__entry, relativePath, mode);
+	while (!result && xdgNextCandidate(&it, relativePath, pathLen))
+	{
+		xdgCount(xdgStatistics.probes, 1);
+		result = fopen(it.path, mode);
+		xdgProbedCandidate(&it, relativePath, result != 0);
+	}
+	xdgTrace2(open__return, relativePath, result);
+	return result;
+}
+
+/** Find the files corresponding to several relative paths in a directory class of a handle.
+  * @param relativePaths Relative paths to search for.
+  * @param count Number of items in relativePaths.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @param dirClass @c XDG_CLASS_* constant selecting the directories to search.
+  * @param handle Initialized handle, or NULL to use the environment.
+  * @return See xdgFindManyExisting().
+  */
+static char ** xdgFindMany(const char * const * relativePaths, size_t count, int flags, int dirClass, xdgHandle *handle)
+{
+	const char * const * dirs;
+	xdgCachedData *cache;
+	char ** result;
+	int ticket;
+
+	xdgCountLookups(dirClass, count);
+	if (!handle)
+	{
+		dirs = (const char * const *)xdgGetDirectoryBlock(dirClass, TRUE);
+		if (!dirs) return 0;
+		result = xdgFindManyExisting(relativePaths, count, dirs, 0, 0, 0, flags);
+		free((char**)dirs);
+		return result;
+	}
+	ticket = xdgBeginRead(handle);
+	cache = xdgGetCache(handle);
+	result = xdgFindManyExisting(relativePaths, count, (const char * const *)cache->searchable[dirClass],
+		cache->searchableLengths[dirClass], cache->searchableFds[dirClass], cache->searchableCounts[dirClass], flags);
+	xdgEndRead(handle, ticket);
+	return result;
+}
+
+char ** xdgDataFindMany(const char * const * relativePaths, size_t count, int flags, xdgHandle *handle)
+{
+	return xdgFindMany(relativePaths, count, flags, XDG_CLASS_DATA, handle);
+}
+char ** xdgConfigFindMany(const char * const * relativePaths, size_t count, int flags, xdgHandle *handle)
+{
+	return xdgFindMany(relativePaths, count, flags, XDG_CLASS_CONFIG, handle);
+}
+
+/** Fill in the metadata of a found file. */
+static void xdgFillFoundFile(xdgFoundFile *file, const struct stat *st)
+{
+	file->device = (unsigned long long)st->st_dev;
+	file->inode = (unsigned long long)st->st_ino;
+	file->size = (unsigned long long)st->st_size;
+	file->seconds = (long long)st->st_mtime;
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC || !defined(HAVE_CONFIG_H)
+	file->nanoseconds = st->st_mtim.tv_nsec;
+#else
+	file->nanoseconds = 0;
+#endif
+}
+
+/** Decide from the metadata of a candidate file whether it satisfies the probe mode.
+  * Readability is only told by the mode bits for files of the effective
+  * user, as access control lists and privileges may decide otherwise.
+  * @param st Metadata of the candidate.
+  * @param euid Effective user id of the process.
+  * @param flags Bitwise or of @c XDG_FIND_* flags, without @c XDG_FIND_FOPEN.
+  * @return TRUE or FALSE, or -1 if access has to be checked.
+  */
+static int xdgStatSatisfies(const struct stat *st, uid_t euid, int flags)
+{
+	if ((flags & XDG_FIND_REGULAR) && !S_ISREG(st->st_mode))
+		return FALSE;
+	if (flags & XDG_FIND_EXISTS)
+		return TRUE;
+	if (euid != 0 && st->st_uid == euid)
+		return (st->st_mode & S_IRUSR) != 0;
+	return -1;
+}
+
+/** Test whether a candidate file satisfies the probe mode, and get its metadata.
+  * Like xdgProbeFile(), but the file is examined with a single stat(2)
+  * or fstat(2), so that the metadata is that of the file that was found.
+  * @param dirFd Open file descriptor of the directory of the candidate, or -1.
+  * @param fullPath Path of the candidate file.
+  * @param relativePath Path of the candidate relative to dirFd, see xdgRelativeToFd().
+  * @param euid Effective user id of the process.
+  * @param flags Bitwise or of @c XDG_FIND_* flags.
+  * @param st Receives the metadata of a found file.
+  * @return TRUE if the file should be considered found, else FALSE.
+  */
+static int xdgStatCandidate(int dirFd, const char * fullPath, const char * relativePath, uid_t euid,
+	int flags, struct stat *st)
+{
+	FILE * testFile;
+	int found;
+#ifdef XDG_HAVE_DIRFDS
+	int fd;
+#endif
+
+	xdgCount(xdgStatistics.probes, 1);
+#ifdef XDG_HAVE_DIRFDS
+	if (dirFd >= 0)
+	{
+		if (flags & XDG_FIND_FOPEN)
+		{
+			if ((fd = openat(dirFd, relativePath, O_RDONLY | O_CLOEXEC)) == -1)
+				return FALSE;
+			found = fstat(fd, st) == 0 && xdgStatSatisfies(st, euid, flags | XDG_FIND_EXISTS);
+			close(fd);
+			return found;
+		}
+		if (fstatat(dirFd, relativePath, st, 0) == -1)
+			return FALSE;
+		if ((found = xdgStatSatisfies(st, euid, flags)) == -1)
+			found = faccessat(dirFd, relativePath, R_OK, AT_EACCESS) == 0;
+		return found;
+	}
+#else
+	(void)dirFd;
+	(void)relativePath;
+#endif
+	if (flags & XDG_FIND_FOPEN)
+	{
+		if (!(testFile = fopen(fullPath, "r")))
+			return FALSE;
+		found = fstat(fileno(testFile), st) == 0 && xdgStatSatisfies(st, euid, flags | XDG_FIND_EXISTS);
+		fclose(testFile);
+		return found;
+	}
+	if (stat(fullPath, st) == -1)
+		return FALSE;
+	if ((found = xdgStatSatisfies(st, euid, flags)) != -1)
+		return found;
+#if HAVE_FACCESSAT || !defined(HAVE_CONFIG_H)
+	return faccessat(AT_FDCWD, fullPath, R_OK, AT_EACCESS) == 0;
+#else
+	return access(fullPath, R_OK) == 0;
+#endif
+}
+
+/** Find all existing files corresponding to relativePath relative to each item in dirList, with their metadata.
+  * Every candidate is examined once, see xdgStatCandidate().
   * @param relativePath Relative path to search for.
   * @param dirList <tt>NULL</tt>-terminated list of directory paths.
-  * @return A sequence of null-terminated strings terminated by a
-  * 	double-<tt>NULL</tt> (empty string) and allocated using malloc().
+  * @param dirLengths xdgDirectoryLength() of each item in dirList, or NULL to measure them.
+  * @param dirFds List of directory file descriptors parallel to dirList, or NULL.
+  * @param dirCounts Hit and miss counts for each item in dirList, or NULL.
+  * @param flags Bitwise or of @c XDG_FIND_* flags selecting the probe mode.
+  * @return See xdgFindFiles().
   */
-static char * xdgFindExisting(const char * relativePath, const char * const * dirList)
+static xdgFoundFile * xdgStatExisting(const char * relativePath, const char * const * dirList,
+	const size_t * dirLengths, const int * dirFds, unsigned long * dirCounts, int flags)
+{
+	struct stat st;
+	xdgFoundFile *result;
+	char *strings;
+	size_t pathLen = strlen(relativePath);
+	size_t dirCount, dirLen, size = 0, i = 0, d;
+	uid_t euid = geteuid();
+
+	/* every directory may hold a hit, so room is made for all of them */
+	for (dirCount = 0; dirList[dirCount]; ++dirCount)
+	{
+		dirLen = dirLengths ? dirLengths[dirCount] : xdgDirectoryLength(dirList[dirCount]);
+		if (dirLen+pathLen+2 > (size_t)-1-size)
+		{
+			errno = ENOMEM;
+			return 0;
+		}
+		size += dirLen+pathLen+2;
+	}
+	if (dirCount+1 > ((size_t)-1-size)/sizeof(xdgFoundFile))
+	{
+		errno = ENOMEM;
+		return 0;
+	}
+	if (!(result = (xdgFoundFile*)xdgMalloc(sizeof(xdgFoundFile)*(dirCount+1)+size)))
+		return 0;
+	strings = (char*)(result+dirCount+1);
+	for (d = 0; d < dirCount; ++d)
+	{
+		dirLen = dirLengths ? dirLengths[d] : xdgDirectoryLength(dirList[d]);
+		xdgJoinMeasured(strings, dirLen+pathLen+2, dirList[d], dirLen, relativePath, pathLen);
+		if (!xdgStatCandidate(dirFds ? dirFds[d] : -1, strings, xdgRelativeToFd(relativePath), euid, flags, &st))
+		{
+			xdgProbed(dirCounts, relativePath, dirList, d, FALSE);
+			continue;
+		}
+		xdgProbed(dirCounts, relativePath, dirList, d, TRUE);
+		xdgFillFoundFile(&result[i], &st);
+		result[i++].path = strings;
+		strings += dirLen+pathLen+2;
+	}
+	xdgZeroMemory(&result[i], sizeof(xdgFoundFile));
+	return result;
+}
+
+xdgFoundFile * xdgFindFiles(xdgDirectoryClass dirClass, const char * relativePath, int flags, xdgHandle *handle)
+{
+	const char * const * dirs;
+	xdgCachedData *cache;
+	xdgFoundFile *result;
+	int ticket;
+
+	if (!xdgCheckClass(dirClass)) return 0;
+	xdgCountLookups(dirClass, 1);
+	if (!handle)
+	{
+		dirs = (const char * const *)xdgGetDirectoryBlock(dirClass, TRUE);
+		if (!dirs) return 0;
+		result = xdgStatExisting(relativePath, dirs, 0, 0, 0, flags);
+		free((char**)dirs);
+		return result;
+	}
+	ticket = xdgBeginRead(handle);
+	cache = xdgGetCache(handle);
+	result = xdgStatExisting(relativePath, (const char * const *)cache->searchable[dirClass],
+		cache->searchableLengths[dirClass], cache->searchableFds[dirClass], cache->searchableCounts[dirClass], flags);
+	xdgEndRead(handle, ticket);
+	return result;
+}
+xdgFoundFile * xdgDataFindFiles(const char * relativePath, int flags, xdgHandle *handle)
+{
+	return xdgFindFiles(XDG_DATA, relativePath, flags, handle);
+}
+xdgFoundFile * xdgConfigFindFiles(const char * relativePath, int flags, xdgHandle *handle)
 {
+	return xdgFindFiles(XDG_CONFIG, relativePath, flags, handle);
+}
+
+int xdgFilesChanged(const xdgFoundFile *files)
+{
+	xdgFoundFile current;
+	struct stat st;
+
+	for (; files->path; ++files)
+	{
+		xdgCount(xdgStatistics.probes, 1);
+		if (stat(files->path, &st) == -1)
+			return TRUE;
+		xdgFillFoundFile(&current, &st);
+		if (current.device != files->device || current.inode != files->inode || current.size != files->size ||
+			current.seconds != files->seconds || current.nanoseconds != files->nanoseconds)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+#ifdef XDG_HAVE_PTHREAD
+/** Number of threads probing and reading directories in the background. */
+#define XDG_ASYNC_THREADS 4
+
+/** Work on one directory, queued for the worker threads. */
+typedef struct _xdgAsyncTask
+{
+	struct _xdgAsyncTask * next;
+	/** Function doing the work, called on a worker thread. */
+	void (*run)(struct _xdgAsyncTask * task);
+	/** The lookup or enumeration the task is part of. */
+	void * owner;
+	/** Index of the directory in the directory list of the owner. */
+	size_t index;
+} xdgAsyncTask;
+
+/** Asynchronous lookup, allocated as one block holding its tasks,
+  * the relative path and a copy of the searched directories. */
+typedef struct _xdgAsyncFind
+{
+	xdgFindCallback callback;
+	void * userData;
+	int flags;
+	/** Number of tasks not finished yet, protected by xdgAsyncLock. */
+	size_t pending;
+	size_t count;
+	const char * relativePath;
+	const char ** dirs;
+	unsigned char * found;
+	xdgAsyncTask tasks[1];
+} xdgAsyncFind;
+
+static pthread_mutex_t xdgAsyncLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xdgAsyncWakeup = PTHREAD_COND_INITIALIZER;
+static xdgAsyncTask * xdgAsyncHead;
+static xdgAsyncTask ** xdgAsyncTail = &xdgAsyncHead;
+static pthread_once_t xdgAsyncOnce = PTHREAD_ONCE_INIT;
+/** Number of worker threads started, 0 if none could be. */
+static int xdgAsyncThreads;
+static pthread_t xdgAsyncWorkers[XDG_ASYNC_THREADS];
+/** Set when the library is unloaded, protected by xdgAsyncLock. */
+static int xdgAsyncStopping;
+
+/** Collect the results of a finished asynchronous lookup and report them. */
+static void xdgCompleteAsyncFind(xdgAsyncFind * find)
+{
+	size_t size = 1, i;
+	char * result, * ptr;
+
+	for (i = 0; i < find->count; ++i)
+		if (find->found[i])
+			size += xdgJoinPath(0, 0, find->dirs[i], find->relativePath)+1;
+	if (!(result = (char*)xdgMalloc(size)))
+	{
+		find->callback(0, ENOMEM, find->userData);
+		free(find);
+		return;
+	}
+	ptr = result;
+	for (i = 0; i < find->count; ++i)
+	{
+		if (!find->found[i]) continue;
+		ptr += xdgJoinPath(ptr, size-(ptr-result), find->dirs[i], find->relativePath)+1;
+		if (find->flags & XDG_FIND_FIRST)
+			break;
+	}
+	*ptr = 0;
+	xdgTrace2(find__return, find->relativePath, (size_t)(ptr-result)+1);
+	find->callback(result, 0, find->userData);
+	free(find);
+}
+
+/** Probe one directory for an asynchronous lookup, completing it after the last one. */
+static void xdgRunAsyncProbe(xdgAsyncTask * task)
+{
+	xdgAsyncFind * find = (xdgAsyncFind*)task->owner;
+	char pathBuffer[PATH_MAX];
 	char * fullPath;
-	char * returnString = 0;
-	char * tmpString;
-	int strLen = 0;
-	FILE * testFile;
-	const char * const * item;
+	size_t length;
+	int found;
+
+	length = xdgJoinPath(pathBuffer, sizeof(pathBuffer), find->dirs[task->index], find->relativePath);
+	if (length < sizeof(pathBuffer))
+		fullPath = pathBuffer;
+	else if ((fullPath = (char*)xdgMalloc(length+1)))
+		xdgJoinPath(fullPath, length+1, find->dirs[task->index], find->relativePath);
+	found = fullPath && xdgProbeFile(fullPath, find->flags);
+	if (fullPath != pathBuffer)
+		free(fullPath);
+	xdgProbed(0, find->relativePath, find->dirs, task->index, found);
+	find->found[task->index] = found;
+
+	pthread_mutex_lock(&xdgAsyncLock);
+	found = --find->pending == 0;
+	pthread_mutex_unlock(&xdgAsyncLock);
+	if (found)
+		xdgCompleteAsyncFind(find);
+}
+
+/** Report the empty result of an asynchronous lookup without directories. */
+static void xdgRunAsyncCompletion(xdgAsyncTask * task)
+{
+	xdgCompleteAsyncFind((xdgAsyncFind*)task->owner);
+}
+
+/** Worker thread running queued tasks until the library is unloaded. */
+static void * xdgAsyncWorker(void * unused)
+{
+	xdgAsyncTask * task;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&xdgAsyncLock);
+		while (!xdgAsyncStopping && !(task = xdgAsyncHead))
+			pthread_cond_wait(&xdgAsyncWakeup, &xdgAsyncLock);
+		if (xdgAsyncStopping)
+		{
+			pthread_mutex_unlock(&xdgAsyncLock);
+			break;
+		}
+		if (!(xdgAsyncHead = task->next))
+			xdgAsyncTail = &xdgAsyncHead;
+		pthread_mutex_unlock(&xdgAsyncLock);
+		task->run(task);
+	}
+	return unused;
+}
+
+/** Queue a list of tasks linked through xdgAsyncTask::next for the worker threads. */
+static void xdgQueueAsyncTasks(xdgAsyncTask * first, xdgAsyncTask * last)
+{
+	pthread_mutex_lock(&xdgAsyncLock);
+	*xdgAsyncTail = first;
+	xdgAsyncTail = &last->next;
+	pthread_cond_broadcast(&xdgAsyncWakeup);
+	pthread_mutex_unlock(&xdgAsyncLock);
+}
+
+/** Forget the worker threads in a child process, which has none of them. */
+static void xdgForgetAsyncWorkers(void)
+{
+	xdgAsyncThreads = 0;
+}
+
+/** Start the worker threads for asynchronous lookups. */
+static void xdgStartAsyncWorkers(void)
+{
+	int i;
+
+	if (pthread_atfork(0, 0, xdgForgetAsyncWorkers) != 0) return;
+	for (i = 0; i < XDG_ASYNC_THREADS; ++i)
+		if (pthread_create(&xdgAsyncWorkers[xdgAsyncThreads], 0, xdgAsyncWorker, 0) == 0)
+			++xdgAsyncThreads;
+}
+
+#ifdef __GNUC__
+/** Stop and join the worker threads when the library is unloaded, so
+  * that none is left running code that is no longer mapped. Tasks still
+  * queued are dropped, a task in progress is finished first.
+  */
+static void xdgStopAsyncWorkers(void) __attribute__((destructor));
+static void xdgStopAsyncWorkers(void)
+{
+	int i;
+
+	pthread_mutex_lock(&xdgAsyncLock);
+	xdgAsyncStopping = TRUE;
+	pthread_cond_broadcast(&xdgAsyncWakeup);
+	pthread_mutex_unlock(&xdgAsyncLock);
+	for (i = 0; i < xdgAsyncThreads; ++i)
+	{
+		/* exit() may be called by a callback */
+		if (!pthread_equal(xdgAsyncWorkers[i], pthread_self()))
+			pthread_join(xdgAsyncWorkers[i], 0);
+	}
+}
+#endif
+#endif
+
+/** Start an asynchronous lookup in a directory class.
+  * The searched directories are copied, so the handle may be updated or
+  * wiped while the lookup is in progress.
+  * @return TRUE if the lookup was started, else FALSE with errno set.
+  */
+static int xdgFindAsync(const char * relativePath, int flags, int dirClass,
+	xdgFindCallback callback, void * userData, xdgHandle *handle)
+{
+#ifdef XDG_HAVE_PTHREAD
+	const char * const * dirs;
+	xdgCachedData * cache = 0;
+	xdgAsyncFind * find;
+	size_t count, size, i;
+	char * strings;
+	int ticket = 0;
+
+	pthread_once(&xdgAsyncOnce, xdgStartAsyncWorkers);
+	if (!xdgAsyncThreads)
+	{
+		errno = EAGAIN;
+		return FALSE;
+	}
+	xdgCountLookups(dirClass, 1);
+	if (handle)
+	{
+		ticket = xdgBeginRead(handle);
+		cache = xdgGetCache(handle);
+		dirs = (const char * const *)cache->searchable[dirClass];
+	}
+	else if (!(dirs = (const char * const *)xdgGetDirectoryBlock(dirClass, TRUE)))
+		return FALSE;
+
+	size = strlen(relativePath)+1;
+	for (count = 0; dirs[count]; ++count)
+		size += strlen(dirs[count])+1;
+	size += sizeof(xdgAsyncFind) + (sizeof(xdgAsyncTask)+sizeof(char*)+1)*count;
+	if ((find = (xdgAsyncFind*)xdgMalloc(size)))
+	{
+		/* tasks, then directory pointers, then found flags and strings */
+		find->callback = callback;
+		find->userData = userData;
+		find->flags = flags;
+		find->pending = find->count = count;
+		/* without directories a single task reports the empty result */
+		find->tasks[0].run = xdgRunAsyncCompletion;
+		find->tasks[0].owner = find;
+		find->tasks[0].index = 0;
+		find->tasks[0].next = 0;
+		find->dirs = (const char **)(find->tasks+(count ? count : 1));
+		find->found = (unsigned char *)(find->dirs+count);
+		strings = (char*)(find->found+count);
+		for (i = 0; i < count; ++i)
+		{
+			find->tasks[i].run = xdgRunAsyncProbe;
+			find->tasks[i].owner = find;
+			find->tasks[i].index = i;
+			find->tasks[i].next = i+1 < count ? &find->tasks[i+1] : 0;
+			find->dirs[i] = strings;
+			strcpy(strings, dirs[i]);
+			strings += strlen(strings)+1;
+			find->found[i] = 0;
+		}
+		find->relativePath = strings;
+		strcpy(strings, relativePath);
+	}
+	if (handle)
+		xdgEndRead(handle, ticket);
+	else
+		free((char**)dirs);
+	if (!find)
+		return FALSE;
+
+	xdgTrace2(find__entry, find->relativePath, flags);
+	xdgQueueAsyncTasks(&find->tasks[0], &find->tasks[count ? count-1 : 0]);
+	return TRUE;
+#else
+	errno = ENOSYS;
+	return FALSE;
+#endif
+}
+
+int xdgDataFindAsync(const char * relativePath, int flags, xdgFindCallback callback, void * userData, xdgHandle *handle)
+{
+	return xdgFindAsync(relativePath, flags, XDG_CLASS_DATA, callback, userData, handle);
+}
+int xdgConfigFindAsync(const char * relativePath, int flags, xdgFindCallback callback, void * userData, xdgHandle *handle)
+{
+	return xdgFindAsync(relativePath, flags, XDG_CLASS_CONFIG, callback, userData, handle);
+}
+
+char * xdgFind(xdgDirectoryClass dirClass, const char * relativePath, int flags, xdgHandle *handle)
+{
+	if (!xdgCheckClass(dirClass)) return 0;
+	return xdgFindAllocated(relativePath, flags, dirClass, handle);
+}
+char * xdgDataFindEx(const char * relativePath, int flags, xdgHandle *handle)
+{
+	return xdgFindAllocated(relativePath, flags, XDG_CLASS_DATA, handle);
+}
+char * xdgConfigFindEx(const char * relativePath, int flags, xdgHandle *handle)
+{
+	return xdgFindAllocated(relativePath, flags, XDG_CLASS_CONFIG, handle);
+}
+size_t xdgDataFindInto(const char * relativePath, int flags, char * buffer, size_t size, xdgHandle *handle)
+{
+	return xdgFindInto(relativePath, flags, XDG_CLASS_DATA, buffer, size, 0, handle);
+}
+size_t xdgConfigFindInto(const char * relativePath, int flags, char * buffer, size_t size, xdgHandle *handle)
+{
+	return xdgFindInto(relativePath, flags, XDG_CLASS_CONFIG, buffer, size, 0, handle);
+}
+/** Reduce the result of a lookup with @c XDG_FIND_FIRST to its first string.
+  * Such a result holds at most one path, so it is returned as is if it
+  * is not empty.
+  */
+static char * xdgFirstResult(char * result)
+{
+	if (result && !*result)
+	{
+		free(result);
+		errno = ENOENT;
+		return 0;
+	}
+	return result;
+}
+
+char * xdgDataFindFirst(const char * relativePath, int flags, xdgHandle *handle)
+{
+	return xdgFirstResult(xdgDataFindEx(relativePath, flags | XDG_FIND_FIRST, handle));
+}
+char * xdgConfigFindFirst(const char * relativePath, int flags, xdgHandle *handle)
+{
+	return xdgFirstResult(xdgConfigFindEx(relativePath, flags | XDG_FIND_FIRST, handle));
+}
+struct _xdgEnumeration
+{
+	/** Directories to read, copied when the enumeration starts. */
+	char ** dirs;
+	/** Index of the next directory in dirs to open. */
+	size_t nextDir;
+#ifdef XDG_HAVE_LISTINGS
+	/** The directory being read, or NULL. */
+	DIR * current;
+#endif
+	char * relativeDirectory;
+	/** Pattern names must match, or NULL. */
+	char * pattern;
+	int flags;
+	/** Path of the last result, starting with the path of the current directory. */
+	char * path;
+	size_t pathCapacity;
+	/** Length of the path of the current directory including a trailing separator. */
+	size_t pathPrefix;
+	/* Note: names reported so far are kept in names, each preceded by */
+	/* an unused byte so that no offset is 0, see xdgFindNameSlot(). */
+	char * names;
+	size_t namesCapacity;
+	size_t namesUsed;
+	unsigned int * slots;
+	unsigned int slotCount;
+	unsigned int nameCount;
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+	/** Reads of every directory queued for the worker threads, or NULL
+	  * if the directories are read one after another. */
+	xdgAsyncTask * tasks;
+	/** Listings read by the tasks, valid once set in ready. */
+	xdgListing ** listings;
+	unsigned char * ready;
+	/** Number of tasks that have not finished, protected by xdgAsyncLock. */
+	size_t pending;
+	/** Signalled with xdgAsyncLock held whenever a task finishes. */
+	pthread_cond_t finished;
+	/** Listing of the current directory, or NULL. */
+	xdgListing * listing;
+	/** Offset of the next entry in the current listing. */
+	size_t nextEntry;
+#endif
+};
+
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+/** Read one directory of a parallel enumeration. */
+static void xdgRunAsyncListing(xdgAsyncTask * task)
+{
+	xdgEnumeration * enumeration = (xdgEnumeration*)task->owner;
+	xdgListing * listing;
+
+	listing = xdgReadListing(enumeration->dirs[task->index], enumeration->relativeDirectory);
+	pthread_mutex_lock(&xdgAsyncLock);
+	enumeration->listings[task->index] = listing;
+	enumeration->ready[task->index] = TRUE;
+	--enumeration->pending;
+	pthread_cond_broadcast(&enumeration->finished);
+	pthread_mutex_unlock(&xdgAsyncLock);
+}
+
+/** Queue reads of all directories of an enumeration for the worker threads.
+  * Enumerations that cannot be parallelized are left to read their
+  * directories one after another.
+  * @return TRUE if the reads were queued, else FALSE. */
+static int xdgStartParallelListings(xdgEnumeration * enumeration, size_t count)
+{
+	size_t i;
+
+	if (!count) return FALSE;
+	pthread_once(&xdgAsyncOnce, xdgStartAsyncWorkers);
+	if (!xdgAsyncThreads || pthread_cond_init(&enumeration->finished, 0) != 0)
+		return FALSE;
+	for (i = 0; i < count; ++i)
+	{
+		enumeration->tasks[i].next = i+1 < count ? &enumeration->tasks[i+1] : 0;
+		enumeration->tasks[i].run = xdgRunAsyncListing;
+		enumeration->tasks[i].owner = enumeration;
+		enumeration->tasks[i].index = i;
+		enumeration->listings[i] = 0;
+		enumeration->ready[i] = FALSE;
+	}
+	enumeration->pending = count;
+	enumeration->listing = 0;
+	xdgQueueAsyncTasks(&enumeration->tasks[0], &enumeration->tasks[count-1]);
+	return TRUE;
+}
+#endif
 
-	for (item = dirList; *item; item++)
+/** Start an enumeration of a subdirectory of all directories of a class.
+  * The directories, relativeDirectory and pattern are copied into the
+  * same allocation as the iterator.
+  * @return The iterator, or NULL on failure.
+  */
+static xdgEnumeration * xdgEnumerate(const char * relativeDirectory, const char * pattern, int flags,
+	int dirClass, xdgHandle *handle)
+{
+#ifdef XDG_HAVE_LISTINGS
+	const char * const * dirs;
+	xdgEnumeration * enumeration;
+	xdgCachedData * cache;
+	size_t count, size, i;
+	char * strings;
+	int ticket = 0;
+
+#ifndef XDG_HAVE_FNMATCH
+	if (pattern)
+	{
+		errno = ENOSYS;
+		return 0;
+	}
+#endif
+	if (handle)
+	{
+		ticket = xdgBeginRead(handle);
+		cache = xdgGetCache(handle);
+		dirs = (const char * const *)cache->searchable[dirClass];
+	}
+	else if (!(dirs = (const char * const *)xdgGetDirectoryBlock(dirClass, TRUE)))
+		return 0;
+
+	size = sizeof(xdgEnumeration) + strlen(relativeDirectory)+1 + (pattern ? strlen(pattern)+1 : 0);
+	for (count = 0; dirs[count]; ++count)
+		size += sizeof(char*) + strlen(dirs[count])+1;
+	size += sizeof(char*);
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+	if (flags & XDG_ENUMERATE_PARALLEL)
+		size += (sizeof(xdgAsyncTask)+sizeof(xdgListing*)+1)*count;
+#endif
+	if ((enumeration = (xdgEnumeration*)xdgMalloc(size)))
 	{
-		if (!(fullPath = (char*)malloc(strlen(*item)+strlen(relativePath)+2)))
+		xdgZeroMemory(enumeration, sizeof(xdgEnumeration));
+		enumeration->flags = flags & ~(XDG_FIND_FIRST | XDG_ENUMERATE_PARALLEL);
+		strings = (char*)(enumeration+1);
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+		if (flags & XDG_ENUMERATE_PARALLEL)
 		{
-			if (returnString) free(returnString);
-			return 0;
+			enumeration->tasks = (xdgAsyncTask*)strings;
+			enumeration->listings = (xdgListing**)(enumeration->tasks+count);
+			strings = (char*)(enumeration->listings+count);
 		}
-		strcpy(fullPath, *item);
-		if (fullPath[strlen(fullPath)-1] != DIR_SEPARATOR_CHAR)
-			strcat(fullPath, DIR_SEPARATOR_STR);
-		strcat(fullPath, relativePath);
-		testFile = fopen(fullPath, "r");
-		if (testFile)
+#endif
+		enumeration->dirs = (char**)strings;
+		strings = (char*)(enumeration->dirs+count+1);
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+		if (flags & XDG_ENUMERATE_PARALLEL)
 		{
-			if (!(tmpString = (char*)realloc(returnString, strLen+strlen(fullPath)+2)))
-			{
-				free(returnString);
-				free(fullPath);
-				return 0;
-			}
-			returnString = tmpString;
-			strcpy(&returnString[strLen], fullPath);
-			strLen = strLen+strlen(fullPath)+1;
-			fclose(testFile);
+			enumeration->ready = (unsigned char*)strings;
+			strings += count;
+		}
+#endif
+		for (i = 0; i < count; ++i)
+		{
+			enumeration->dirs[i] = strings;
+			strcpy(strings, dirs[i]);
+			strings += strlen(strings)+1;
+		}
+		enumeration->dirs[count] = 0;
+		enumeration->relativeDirectory = strings;
+		strcpy(strings, relativeDirectory);
+		if (pattern)
+		{
+			enumeration->pattern = strings+strlen(strings)+1;
+			strcpy(enumeration->pattern, pattern);
 		}
-		free(fullPath);
 	}
-	if (returnString)
-		returnString[strLen] = 0;
+	if (handle)
+		xdgEndRead(handle, ticket);
 	else
+		free((char**)dirs);
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+	if (enumeration && enumeration->tasks && !xdgStartParallelListings(enumeration, count))
+		enumeration->tasks = 0;
+#endif
+	return enumeration;
+#else
+	errno = ENOSYS;
+	return 0;
+#endif
+}
+
+xdgEnumeration * xdgDataEnumerate(const char * relativeDirectory, const char * pattern, int flags, xdgHandle *handle)
+{
+	return xdgEnumerate(relativeDirectory, pattern, flags, XDG_CLASS_DATA, handle);
+}
+
+xdgEnumeration * xdgConfigEnumerate(const char * relativeDirectory, const char * pattern, int flags, xdgHandle *handle)
+{
+	return xdgEnumerate(relativeDirectory, pattern, flags, XDG_CLASS_CONFIG, handle);
+}
+
+#ifdef XDG_HAVE_LISTINGS
+/** Set the path of an enumeration to the listed directory in dir.
+  * @return The length of the path, or (size_t)-1 if out of memory. */
+static size_t xdgSetEnumerationPath(xdgEnumeration * enumeration, const char * dir)
+{
+	size_t length = xdgJoinPath(0, 0, dir, enumeration->relativeDirectory);
+	if (!xdgReserve(&enumeration->path, &enumeration->pathCapacity, 0, length+2))
 	{
-		if ((returnString = (char*)malloc(2)))
-			strcpy(returnString, "\0");
+		errno = ENOMEM;
+		return (size_t)-1;
 	}
-	return returnString;
+	xdgJoinPath(enumeration->path, length+1, dir, enumeration->relativeDirectory);
+	return length;
 }
 
-/** Open first possible config file corresponding to relativePath.
-  * @param relativePath Path to scan for.
-  * @param mode Mode with which to attempt to open files (see fopen modes).
-  * @param dirList <tt>NULL</tt>-terminated list of paths in which to search for relativePath.
-  * @return File pointer if successful else @c NULL. Client must use @c fclose to close file.
-  */
-static FILE * xdgFileOpen(const char * relativePath, const char * mode, const char * const * dirList)
+/** End the path of an enumeration's current directory with a separator. */
+static void xdgSetEnumerationPrefix(xdgEnumeration * enumeration, size_t length)
 {
-	char * fullPath;
-	FILE * testFile;
-	const char * const * item;
+	if (length && enumeration->path[length-1] != DIR_SEPARATOR_CHAR)
+		enumeration->path[length++] = DIR_SEPARATOR_CHAR;
+	enumeration->pathPrefix = length;
+}
 
-	for (item = dirList; *item; item++)
+/** Open the next directory of an enumeration that can be read.
+  * @return TRUE if a directory was opened, FALSE at the end or on failure. */
+static int xdgOpenNextDirectory(xdgEnumeration * enumeration)
+{
+	const char * dir;
+	size_t length;
+
+	while ((dir = enumeration->dirs[enumeration->nextDir]))
 	{
-		if (!(fullPath = (char*)malloc(strlen(*item)+strlen(relativePath)+2)))
-			return 0;
-		strcpy(fullPath, *item);
-		if (fullPath[strlen(fullPath)-1] != DIR_SEPARATOR_CHAR)
-			strcat(fullPath, DIR_SEPARATOR_STR);
-		strcat(fullPath, relativePath);
-		testFile = fopen(fullPath, mode);
-		free(fullPath);
-		if (testFile)
-			return testFile;
+		++enumeration->nextDir;
+		if ((length = xdgSetEnumerationPath(enumeration, dir)) == (size_t)-1)
+			return FALSE;
+		if (!(enumeration->current = opendir(enumeration->path)))
+			continue;
+		xdgSetEnumerationPrefix(enumeration, length);
+		return TRUE;
 	}
-	return 0;
+	errno = 0;
+	return FALSE;
 }
 
-int xdgMakePath(const char * path, mode_t mode)
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+/** Wait for the listing of the next directory of a parallel enumeration
+  * that could be read.
+  * @return TRUE if a listing became current, FALSE at the end or on failure. */
+static int xdgWaitNextListing(xdgEnumeration * enumeration)
 {
-	int length = strlen(path);
-	char * tmpPath;
-	char * tmpPtr;
-	int ret;
+	xdgListing * listing;
+	size_t index, length;
 
-	if (length == 0 || (length == 1 && path[0] == DIR_SEPARATOR_CHAR))
-		return 0;
+	while (enumeration->dirs[index = enumeration->nextDir])
+	{
+		++enumeration->nextDir;
+		pthread_mutex_lock(&xdgAsyncLock);
+		while (!enumeration->ready[index])
+			pthread_cond_wait(&enumeration->finished, &xdgAsyncLock);
+		pthread_mutex_unlock(&xdgAsyncLock);
+		listing = enumeration->listings[index];
+		/* a listing that could not be allocated is a directory that could not be read */
+		if (!listing || listing->status != XDG_LISTING_READ)
+			continue;
+		if ((length = xdgSetEnumerationPath(enumeration, enumeration->dirs[index])) == (size_t)-1)
+			return FALSE;
+		xdgSetEnumerationPrefix(enumeration, length);
+		enumeration->listing = listing;
+		enumeration->nextEntry = 1;
+		return TRUE;
+	}
+	errno = 0;
+	return FALSE;
+}
+#endif
+
+/** Remember that a name has been reported by an enumeration.
+  * @return TRUE if successful, FALSE if out of memory. */
+static int xdgAddReportedName(xdgEnumeration * enumeration, const char * name)
+{
+	size_t length = strlen(name)+1, offset;
+	unsigned int * slots, count, slot;
 
-	if (!(tmpPath = (char*)malloc(length+1)))
+	if ((enumeration->nameCount+1)*2 > enumeration->slotCount)
 	{
-		errno = ENOMEM;
-		return -1;
+		/* grow and rehash, keeping at most half of the slots in use */
+		count = MAX(enumeration->slotCount*2, 64);
+		if (!(slots = (unsigned int*)xdgCalloc(count, sizeof(unsigned int))))
+			return FALSE;
+		for (offset = 1; offset < enumeration->namesUsed; offset += strlen(enumeration->names+offset)+2)
+			slots[xdgFindNameSlot(slots, count, enumeration->names, enumeration->names+offset)] = offset;
+		free(enumeration->slots);
+		enumeration->slots = slots;
+		enumeration->slotCount = count;
 	}
-	strcpy(tmpPath, path);
-	if (tmpPath[length-1] == DIR_SEPARATOR_CHAR)
-		tmpPath[length-1] = '\0';
+	if (!xdgReserve(&enumeration->names, &enumeration->namesCapacity, enumeration->namesUsed, length+1))
+		return FALSE;
+	offset = enumeration->namesUsed+1;
+	enumeration->names[offset-1] = 0;
+	memcpy(enumeration->names+offset, name, length);
+	enumeration->namesUsed += length+1;
+	slot = xdgFindNameSlot(enumeration->slots, enumeration->slotCount, enumeration->names, name);
+	enumeration->slots[slot] = offset;
+	++enumeration->nameCount;
+	return TRUE;
+}
+
+/** Check whether an entry of the current directory is to be reported.
+  * On success the path of the enumeration is set to the entry.
+  * @param type @c XDG_ENTRY_* constant for the entry.
+  * @return TRUE to report the entry, FALSE to skip it, -1 if out of memory. */
+static int xdgAcceptEntry(xdgEnumeration * enumeration, const char * entryName, int type)
+{
+	size_t length;
+	int hint;
+
+	if (entryName[0] == '.' && (!entryName[1] || (entryName[1] == '.' && !entryName[2])))
+		return FALSE;
+#ifdef XDG_HAVE_FNMATCH
+	if (enumeration->pattern && fnmatch(enumeration->pattern, entryName, 0) != 0)
+		return FALSE;
+#endif
+	if (enumeration->slotCount &&
+		enumeration->slots[xdgFindNameSlot(enumeration->slots, enumeration->slotCount, enumeration->names, entryName)])
+		return FALSE;
+	length = strlen(entryName)+1;
+	if (!xdgReserve(&enumeration->path, &enumeration->pathCapacity, enumeration->pathPrefix, length))
+		return -1;
+	memcpy(enumeration->path+enumeration->pathPrefix, entryName, length);
+	if ((hint = xdgHintForEntry(type, enumeration->flags)) == XDG_HINT_ABSENT ||
+		(hint == XDG_HINT_PROBE && !xdgProbeFile(enumeration->path, enumeration->flags)))
+		return FALSE;
+	return xdgAddReportedName(enumeration, entryName) ? TRUE : -1;
+}
+#endif
+
+const char * xdgEnumerateNext(xdgEnumeration * enumeration, const char ** name)
+{
+#ifdef XDG_HAVE_LISTINGS
+	struct dirent * entry;
+	const char * entryName;
+	int type, accepted;
 
-	/* skip tmpPath[0] since if it's a seperator we have an absolute path */
-	for (tmpPtr = tmpPath+1; *tmpPtr; ++tmpPtr)
+	for (;;)
 	{
-		if (*tmpPtr == DIR_SEPARATOR_CHAR)
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+		if (enumeration->tasks)
 		{
-			*tmpPtr = '\0';
-			if (mkdir(tmpPath, mode) == -1)
+			if (!enumeration->listing && !xdgWaitNextListing(enumeration))
+				return 0;
+			if (enumeration->nextEntry >= (size_t)(enumeration->listing->subdirectory-enumeration->listing->entries))
 			{
-				if (errno != EEXIST)
-				{
-					free(tmpPath);
-					return -1;
-				}
+				enumeration->listing = 0;
+				continue;
+			}
+			entryName = enumeration->listing->entries+enumeration->nextEntry;
+			type = entryName[-1];
+			enumeration->nextEntry += strlen(entryName)+2;
+		}
+		else
+#endif
+		{
+			if (!enumeration->current && !xdgOpenNextDirectory(enumeration))
+				return 0;
+			/* read errors end the directory like its end does */
+			if (!(entry = readdir(enumeration->current)))
+			{
+				closedir(enumeration->current);
+				enumeration->current = 0;
+				continue;
 			}
-			*tmpPtr = DIR_SEPARATOR_CHAR;
+			entryName = entry->d_name;
+			type = xdgEntryType(entry);
+		}
+		if (!(accepted = xdgAcceptEntry(enumeration, entryName, type)))
+			continue;
+		if (accepted < 0)
+		{
+			errno = ENOMEM;
+			return 0;
 		}
+		if (name)
+			*name = enumeration->path+enumeration->pathPrefix;
+		return enumeration->path;
 	}
-	ret = mkdir(tmpPath, mode);
-	free(tmpPath);
-	return ret;
+#else
+	errno = ENOSYS;
+	return 0;
+#endif
 }
 
-/** Get a home directory from the environment or a fallback relative to @c \$HOME.
- * Sets @c errno to @c ENOMEM if unable to allocate duplicate string.
- * Sets @c errno to @c EINVAL if variable is not set or empty.
- * @param envname Name of environment variable.
- * @param relativefallback Path starting with "/" and relative to @c \$HOME to use as fallback.
- * @param fallbacklength @c strlen(relativefallback).
- * @return The home directory path or @c NULL of an error occurs.
- */
-static char * xdgGetRelativeHome(const char *envname, const char *relativefallback, unsigned int fallbacklength)
+void xdgEnumerateEnd(xdgEnumeration * enumeration)
 {
-	char *relhome;
-	if (!(relhome = xdgEnvDup(envname)) && errno != ENOMEM)
+	if (!enumeration) return;
+#ifdef XDG_HAVE_LISTINGS
+	if (enumeration->current)
+		closedir(enumeration->current);
+#endif
+#ifdef XDG_HAVE_PARALLEL_LISTINGS
+	if (enumeration->tasks)
 	{
-		errno = 0;
-		const char *home;
-		unsigned int homelen;
-		if (!(home = xdgGetEnv("HOME")))
-			return NULL;
-		if (!(relhome = (char*)malloc((homelen = strlen(home))+fallbacklength+1))) return NULL;
-		memcpy(relhome, home, homelen);
-		memcpy(relhome+homelen, relativefallback, fallbacklength+1);
+		size_t i;
+		/* the workers write into the enumeration until their tasks finish */
+		pthread_mutex_lock(&xdgAsyncLock);
+		while (enumeration->pending)
+			pthread_cond_wait(&enumeration->finished, &xdgAsyncLock);
+		pthread_mutex_unlock(&xdgAsyncLock);
+		pthread_cond_destroy(&enumeration->finished);
+		for (i = 0; enumeration->dirs[i]; ++i)
+			free(enumeration->listings[i]);
 	}
-	return relhome;
+#endif
+	free(enumeration->path);
+	free(enumeration->names);
+	free(enumeration->slots);
+	free(enumeration);
 }
 
-const char * xdgDataHome(xdgHandle *handle)
+FILE * xdgOpen(xdgDirectoryClass dirClass, const char * relativePath, const char * mode, xdgHandle *handle)
 {
+	if (!xdgCheckClass(dirClass)) return 0;
+	xdgCountLookups(dirClass, 1);
 	if (handle)
-		return xdgGetCache(handle)->dataHome;
-	else
-		return xdgGetRelativeHome("XDG_DATA_HOME", DefaultRelativeDataHome, sizeof(DefaultRelativeDataHome)-1);
+		return xdgOpenInHandle(relativePath, mode, dirClass, handle);
+	return xdgOpenInEnvironment(relativePath, mode, dirClass);
 }
-const char * xdgConfigHome(xdgHandle *handle)
+FILE * xdgDataOpen(const char * relativePath, const char * mode, xdgHandle *handle)
 {
-	if (handle)
-		return xdgGetCache(handle)->configHome;
-	else
-		return xdgGetRelativeHome("XDG_CONFIG_HOME", DefaultRelativeConfigHome, sizeof(DefaultRelativeConfigHome)-1);
+	return xdgOpen(XDG_DATA, relativePath, mode, handle);
 }
-const char * const * xdgDataDirectories(xdgHandle *handle)
+FILE * xdgConfigOpen(const char * relativePath, const char * mode, xdgHandle *handle)
 {
-	if (handle)
-		return (const char * const *)&(xdgGetCache(handle)->searchableDataDirectories[1]);
-	else
-		return (const char * const *)xdgGetDirectoryLists("XDG_DATA_DIRS", NULL, DefaultDataDirectoriesList);
+	return xdgOpen(XDG_CONFIG, relativePath, mode, handle);
 }
-const char * const * xdgSearchableDataDirectories(xdgHandle *handle)
+
+/** Files smaller than this are read rather than mapped, see xdgMap(). */
+#define XDG_MAP_MIN_SIZE 4096
+
+/** Read up to size bytes from the current position of a file.
+  * @return The number of bytes read, which is less than size only at
+  * 	the end of the file, or -1 with errno set.
+  */
+static ssize_t xdgReadFully(int fd, char *buffer, size_t size)
 {
-	if (handle)
-		return (const char * const *)xdgGetCache(handle)->searchableDataDirectories;
-	else
+	size_t used = 0;
+	ssize_t done;
+
+	while (used < size && (done = read(fd, buffer+used, size-used)) != 0)
 	{
-		char *datahome = (char*)xdgDataHome(NULL);
-		char **datadirs = 0;
-		if (datahome && !(datadirs = xdgGetDirectoryLists("XDG_DATA_DIRS", datahome, DefaultDataDirectoriesList)))
-			free(datahome);
-		return (const char * const *)datadirs;
+		if (done == -1 && errno == EINTR)
+			continue;
+		if (done == -1)
+			return -1;
+		used += done;
 	}
+	return used;
 }
-const char * const * xdgConfigDirectories(xdgHandle *handle)
+
+/** Make the contents of an open file available through a mapping.
+  * The descriptor is closed in any case.
+  * @return TRUE if successful, FALSE with errno set otherwise.
+  */
+static int xdgMapFile(int fd, xdgMapping *mapping)
 {
-	if (handle)
-		return (const char * const *)&(xdgGetCache(handle)->searchableConfigDirectories[1]);
-	else
-		return (const char * const *)xdgGetDirectoryLists("XDG_CONFIG_DIRS", NULL, DefaultConfigDirectoriesList);
+	static const char empty[] = "";
+	struct stat st;
+	char *buffer;
+	ssize_t done;
+	size_t size;
+
+	if (fstat(fd, &st) == -1)
+	{
+		close(fd);
+		return FALSE;
+	}
+	if (!S_ISREG(st.st_mode))
+	{
+		close(fd);
+		errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+		return FALSE;
+	}
+	mapping->data = empty;
+	mapping->size = 0;
+	mapping->reserved = 0;
+	if (!st.st_size)
+	{
+		close(fd);
+		return TRUE;
+	}
+	if ((unsigned long long)st.st_size > (size_t)-1)
+	{
+		close(fd);
+		errno = EFBIG;
+		return FALSE;
+	}
+	size = (size_t)st.st_size;
+#ifdef XDG_HAVE_MMAP
+	if (size >= XDG_MAP_MIN_SIZE)
+	{
+		void *map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			return FALSE;
+		mapping->data = (const char*)map;
+		mapping->size = size;
+		return TRUE;
+	}
+#endif
+	if (!(buffer = (char*)xdgMalloc(size)))
+	{
+		close(fd);
+		return FALSE;
+	}
+	/* a file that shrinks in the meantime ends early */
+	done = xdgReadFully(fd, buffer, size);
+	close(fd);
+	if (done == -1)
+	{
+		free(buffer);
+		return FALSE;
+	}
+	mapping->data = buffer;
+	mapping->size = done;
+	mapping->reserved = buffer;
+	return TRUE;
 }
-const char * const * xdgSearchableConfigDirectories(xdgHandle *handle)
+
+int xdgMap(xdgDirectoryClass dirClass, const char * relativePath, xdgMapping *mapping, xdgHandle *handle)
 {
+	xdgCachedData *cache;
+	int fd, ticket;
+
+	if (!xdgCheckClass(dirClass)) return FALSE;
+	xdgCountLookups(dirClass, 1);
 	if (handle)
-		return (const char * const *)xdgGetCache(handle)->searchableConfigDirectories;
-	else
 	{
-		char *confighome = (char*)xdgConfigHome(NULL);
-		char **configdirs = 0;
-		if (confighome && !(configdirs = xdgGetDirectoryLists("XDG_CONFIG_DIRS", confighome, DefaultConfigDirectoriesList)))
-			free(confighome);
-		return (const char * const *)configdirs;
+		ticket = xdgBeginRead(handle);
+		cache = xdgGetCache(handle);
+		fd = xdgOpenFirst(relativePath, (const char * const *)cache->searchable[dirClass],
+			cache->searchableLengths[dirClass], cache->searchableFds[dirClass], cache->searchableCounts[dirClass]);
+		xdgEndRead(handle, ticket);
 	}
+	else
+		fd = xdgOpenFirstInEnvironment(relativePath, dirClass);
+	return fd != -1 && xdgMapFile(fd, mapping);
 }
-const char * xdgCacheHome(xdgHandle *handle)
+int xdgDataMap(const char * relativePath, xdgMapping *mapping, xdgHandle *handle)
 {
-	if (handle)
-		return xdgGetCache(handle)->cacheHome;
-	else
-		return xdgGetRelativeHome("XDG_CACHE_HOME", DefaultRelativeCacheHome, sizeof(DefaultRelativeCacheHome)-1);
+	return xdgMap(XDG_DATA, relativePath, mapping, handle);
 }
-const char * xdgRuntimeDirectory(xdgHandle *handle)
+int xdgConfigMap(const char * relativePath, xdgMapping *mapping, xdgHandle *handle)
 {
-	if (handle)
-		return xdgGetCache(handle)->runtimeDirectory;
-	else
-		return xdgEnvDup("XDG_RUNTIME_DIRECTORY");
+	return xdgMap(XDG_CONFIG, relativePath, mapping, handle);
 }
-char * xdgDataFind(const char * relativePath, xdgHandle *handle)
+
+void xdgUnmap(xdgMapping *mapping)
 {
-	const char * const * dirs = xdgSearchableDataDirectories(handle);
-	char * result = xdgFindExisting(relativePath, dirs);
-	if (!handle) xdgFreeStringList((char**)dirs);
-	return result;
+	if (mapping->reserved)
+		free(mapping->reserved);
+#ifdef XDG_HAVE_MMAP
+	else if (mapping->size)
+		munmap((void*)mapping->data, mapping->size);
+#endif
+	mapping->data = 0;
+	mapping->size = 0;
+	mapping->reserved = 0;
 }
-char * xdgConfigFind(const char * relativePath, xdgHandle *handle)
+
+/** Number of files xdgLoadMany() has open at a time. */
+#define XDG_LOAD_WINDOW 64
+
+/** Open the first file corresponding to relativePath for xdgLoadMany().
+  * @param size Receives the size of the file.
+  * @return A file descriptor, or -1 with errno set.
+  */
+static int xdgOpenForLoad(const char * relativePath, const char * const * dirList, const size_t * dirLengths,
+	const int * dirFds, unsigned long * dirCounts, size_t *size)
 {
-	const char * const * dirs = xdgSearchableConfigDirectories(handle);
-	char * result = xdgFindExisting(relativePath, dirs);
-	if (!handle) xdgFreeStringList((char**)dirs);
-	return result;
+	struct stat st;
+	int fd, error;
+
+	if ((fd = xdgOpenFirst(relativePath, dirList, dirLengths, dirFds, dirCounts)) == -1)
+		return -1;
+	if (fstat(fd, &st) == -1)
+	{
+		error = errno;
+		close(fd);
+		errno = error;
+		return -1;
+	}
+	if (!S_ISREG(st.st_mode) || (unsigned long long)st.st_size >= (size_t)-1/2)
+	{
+		close(fd);
+		errno = S_ISDIR(st.st_mode) ? EISDIR : S_ISREG(st.st_mode) ? EFBIG : EINVAL;
+		return -1;
+	}
+	*size = (size_t)st.st_size;
+#if HAVE_POSIX_FADVISE || !defined(HAVE_CONFIG_H)
+	/* start reading all files of a window before waiting for the first */
+	if (*size)
+		posix_fadvise(fd, 0, *size, POSIX_FADV_WILLNEED);
+#endif
+	return fd;
 }
-FILE * xdgDataOpen(const char * relativePath, const char * mode, xdgHandle *handle)
+
+/** Load the contents of the files corresponding to several relative paths.
+  * Files are opened and read in windows of @c XDG_LOAD_WINDOW, and their
+  * contents are appended to the block of the result, which is grown once
+  * per window.
+  * @param offsets Receives the offset of every file's contents in the block.
+  * @return See xdgLoadMany().
+  */
+static xdgLoadedFile * xdgLoadFiles(const char * const * relativePaths, size_t count, const char * const * dirList,
+	const size_t * dirLengths, const int * dirFds, unsigned long * dirCounts, size_t *offsets)
 {
-	const char * const * dirs = xdgSearchableDataDirectories(handle);
-	FILE * result = xdgFileOpen(relativePath, mode, dirs);
-	if (!handle) xdgFreeStringList((char**)dirs);
+	int fds[XDG_LOAD_WINDOW];
+	xdgLoadedFile *result, *tmp;
+	size_t used, size, start, end, i;
+	ssize_t done;
+
+	if (count > (size_t)-1/sizeof(xdgLoadedFile))
+	{
+		errno = ENOMEM;
+		return 0;
+	}
+	used = sizeof(xdgLoadedFile)*count;
+	if (!(result = (xdgLoadedFile*)xdgMalloc(used ? used : 1)))
+		return 0;
+	for (start = 0; start < count; start = end)
+	{
+		end = count-start < XDG_LOAD_WINDOW ? count : start+XDG_LOAD_WINDOW;
+		size = used;
+		for (i = start; i < end; ++i)
+		{
+			result[i].data = 0;
+			result[i].size = 0;
+			result[i].error = 0;
+			fds[i-start] = xdgOpenForLoad(relativePaths[i], dirList, dirLengths, dirFds, dirCounts, &result[i].size);
+			if (fds[i-start] == -1)
+				result[i].error = errno;
+			else if (result[i].size >= (size_t)-1-size)
+			{
+				/* the block could not hold the file */
+				close(fds[i-start]);
+				fds[i-start] = -1;
+				result[i].size = 0;
+				result[i].error = ENOMEM;
+			}
+			else
+				size += result[i].size+1;
+		}
+		if (size != used)
+		{
+			if (!(tmp = (xdgLoadedFile*)xdgRealloc(result, size)))
+			{
+				for (i = start; i < end; ++i)
+					if (fds[i-start] != -1) close(fds[i-start]);
+				free(result);
+				return 0;
+			}
+			result = tmp;
+		}
+		for (i = start; i < end; ++i)
+		{
+			if (fds[i-start] == -1)
+				continue;
+			/* files that grew since they were measured are cut off */
+			done = xdgReadFully(fds[i-start], (char*)result+used, result[i].size);
+			close(fds[i-start]);
+			if (done == -1)
+			{
+				result[i].error = errno;
+				result[i].size = 0;
+				continue;
+			}
+			offsets[i] = used;
+			result[i].size = done;
+			((char*)result)[used+done] = 0;
+			used += done+1;
+		}
+	}
+	for (i = 0; i < count; ++i)
+		if (!result[i].error)
+			result[i].data = (const char*)result+offsets[i];
 	return result;
 }
-FILE * xdgConfigOpen(const char * relativePath, const char * mode, xdgHandle *handle)
+
+xdgLoadedFile * xdgLoadMany(xdgDirectoryClass dirClass, const char * const * relativePaths, size_t count,
+	xdgHandle *handle)
 {
-	const char * const * dirs = xdgSearchableConfigDirectories(handle);
-	FILE * result = xdgFileOpen(relativePath, mode, dirs);
-	if (!handle) xdgFreeStringList((char**)dirs);
+	const char * const * dirs;
+	xdgCachedData *cache;
+	xdgLoadedFile *result;
+	size_t *offsets;
+	int ticket;
+
+	if (!xdgCheckClass(dirClass)) return 0;
+	if (count > ((size_t)-1-1)/sizeof(size_t))
+	{
+		errno = ENOMEM;
+		return 0;
+	}
+	if (!(offsets = (size_t*)xdgMalloc(sizeof(size_t)*count+1))) return 0;
+	xdgCountLookups(dirClass, count);
+	if (handle)
+	{
+		ticket = xdgBeginRead(handle);
+		cache = xdgGetCache(handle);
+		result = xdgLoadFiles(relativePaths, count, (const char * const *)cache->searchable[dirClass],
+			cache->searchableLengths[dirClass], cache->searchableFds[dirClass], cache->searchableCounts[dirClass],
+			offsets);
+		xdgEndRead(handle, ticket);
+	}
+	else if ((dirs = (const char * const *)xdgGetDirectoryBlock(dirClass, TRUE)))
+	{
+		result = xdgLoadFiles(relativePaths, count, dirs, 0, 0, 0, offsets);
+		free((char**)dirs);
+	}
+	else
+		result = 0;
+	free(offsets);
 	return result;
 }
-
+xdgLoadedFile * xdgDataLoadMany(const char * const * relativePaths, size_t count, xdgHandle *handle)
+{
+	return xdgLoadMany(XDG_DATA, relativePaths, count, handle);
+}
+xdgLoadedFile * xdgConfigLoadMany(const char * const * relativePaths, size_t count, xdgHandle *handle)
+{
+	return xdgLoadMany(XDG_CONFIG, relativePaths, count, handle);
+}
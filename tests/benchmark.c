@@ -0,0 +1,331 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/* Micro-benchmarks for the library, run with "make bench".
+ * The library is linked statically with its allocation and filesystem
+ * functions wrapped (see Makefile.am), so that besides the time per
+ * call the number of allocations and system calls per call is reported.
+ * Calls made inside the C library itself, like the buffer of fopen(),
+ * are not counted. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+static unsigned long allocations, syscalls;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *string);
+int __real_access(const char *path, int mode);
+int __real_faccessat(int dirfd, const char *path, int mode, int flags);
+int __real_stat(const char *path, struct stat *st);
+int __real_fstat(int fd, struct stat *st);
+int __real_fstatat(int dirfd, const char *path, struct stat *st, int flags);
+int __real_open(const char *path, int flags, ...);
+int __real_openat(int dirfd, const char *path, int flags, ...);
+int __real_close(int fd);
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_mkdir(const char *path, mode_t mode);
+int __real_mkdirat(int dirfd, const char *path, mode_t mode);
+
+void *__wrap_malloc(size_t size) { ++allocations; return __real_malloc(size); }
+void *__wrap_calloc(size_t count, size_t size) { ++allocations; return __real_calloc(count, size); }
+void *__wrap_realloc(void *ptr, size_t size) { ++allocations; return __real_realloc(ptr, size); }
+char *__wrap_strdup(const char *string) { ++allocations; return __real_strdup(string); }
+int __wrap_access(const char *path, int mode) { ++syscalls; return __real_access(path, mode); }
+int __wrap_faccessat(int dirfd, const char *path, int mode, int flags) { ++syscalls; return __real_faccessat(dirfd, path, mode, flags); }
+int __wrap_stat(const char *path, struct stat *st) { ++syscalls; return __real_stat(path, st); }
+int __wrap_fstat(int fd, struct stat *st) { ++syscalls; return __real_fstat(fd, st); }
+int __wrap_fstatat(int dirfd, const char *path, struct stat *st, int flags) { ++syscalls; return __real_fstatat(dirfd, path, st, flags); }
+int __wrap_close(int fd) { ++syscalls; return __real_close(fd); }
+FILE *__wrap_fopen(const char *path, const char *mode) { ++syscalls; return __real_fopen(path, mode); }
+int __wrap_mkdir(const char *path, mode_t mode) { ++syscalls; return __real_mkdir(path, mode); }
+int __wrap_mkdirat(int dirfd, const char *path, mode_t mode) { ++syscalls; return __real_mkdirat(dirfd, path, mode); }
+
+int __wrap_open(const char *path, int flags, ...)
+{
+	va_list args;
+	int mode = 0;
+	if (flags & O_CREAT)
+	{
+		va_start(args, flags);
+		mode = va_arg(args, int);
+		va_end(args);
+	}
+	++syscalls;
+	return __real_open(path, flags, mode);
+}
+
+int __wrap_openat(int dirfd, const char *path, int flags, ...)
+{
+	va_list args;
+	int mode = 0;
+	if (flags & O_CREAT)
+	{
+		va_start(args, flags);
+		mode = va_arg(args, int);
+		va_end(args);
+	}
+	++syscalls;
+	return __real_openat(dirfd, path, flags, mode);
+}
+
+#define MAX_DIRECTORIES 100
+#define MAKEPATH_DEPTH 32
+
+static char root[64];
+static unsigned long scale = 1;
+static xdgHandle handle;
+static xdgHandle *queryHandle;
+static const char *queryPath;
+static char makePathBuffer[sizeof(root)+32+MAKEPATH_DEPTH*2];
+static unsigned long makePathCounter;
+static char updateDirs[2][MAX_DIRECTORIES*(sizeof(root)+16)+2];
+
+/* Time a function and report cost per call. */
+void run(const char *name, void (*function)(void), unsigned long iterations)
+{
+	struct timespec start, end;
+	unsigned long startAllocations, startSyscalls, i;
+	double nanoseconds;
+
+	iterations *= scale;
+	function(); /* warm up */
+	startAllocations = allocations;
+	startSyscalls = syscalls;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; ++i)
+		function();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	nanoseconds = (end.tv_sec - start.tv_sec)*1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%-44s %10.0f ns %8.2f allocs %8.2f syscalls\n", name, nanoseconds/iterations,
+		(double)(allocations - startAllocations)/iterations,
+		(double)(syscalls - startSyscalls)/iterations);
+}
+
+void initAndWipe(void)
+{
+	xdgHandle h;
+	if (xdgInitHandle(&h))
+		xdgWipeHandle(&h);
+}
+
+void update(void)
+{
+	xdgUpdateData(&handle);
+}
+
+/* Alternate between two spellings of the data directories, so that
+ * every update rebuilds the cache. */
+void updateChanged(void)
+{
+	static int which;
+	which = !which;
+	setenv("XDG_DATA_DIRS", updateDirs[which], 1);
+	xdgUpdateData(&handle);
+}
+
+void dataHomeNull(void)
+{
+	free((char*)xdgDataHome(NULL));
+}
+
+void dataHomeHandle(void)
+{
+	xdgDataHome(&handle);
+}
+
+void searchableNull(void)
+{
+	const char * const *dirs = xdgSearchableDataDirectories(NULL);
+	const char * const *item;
+	for (item = dirs; *item; ++item)
+		free((char*)*item);
+	free((char**)dirs);
+}
+
+void searchableHandle(void)
+{
+	xdgSearchableDataDirectories(&handle);
+}
+
+void dataFind(void)
+{
+	free(xdgDataFind(queryPath, queryHandle));
+}
+
+void configFind(void)
+{
+	free(xdgConfigFind(queryPath, queryHandle));
+}
+
+void makePathNew(void)
+{
+	char *ptr;
+	int i;
+	ptr = makePathBuffer + sprintf(makePathBuffer, "%s/mk/%lu", root, makePathCounter++);
+	for (i = 0; i < MAKEPATH_DEPTH; ++i)
+		ptr += sprintf(ptr, "/d");
+	xdgMakePath(makePathBuffer, 0700);
+}
+
+void makePathExisting(void)
+{
+	xdgMakePath(makePathBuffer, 0700);
+}
+
+int createFile(const char *file)
+{
+	FILE *f = fopen(file, "w");
+	if (!f) return 0;
+	fclose(f);
+	return 1;
+}
+
+/* Create count directories below root/nCOUNT, hits percent of them
+ * containing a file named hitsPERCENT, and point the environment at them. */
+int setupDirectories(int count)
+{
+	static const int ratios[] = { 0, 10, 50, 100 };
+	char path[sizeof(root)+64];
+	static char dirs[MAX_DIRECTORIES*(sizeof(root)+16)];
+	char *ptr = dirs;
+	int i, r;
+
+	sprintf(path, "%s/n%d", root, count);
+	if (mkdir(path, 0700) != 0) return 0;
+	for (i = 0; i < count; ++i)
+	{
+		sprintf(path, "%s/n%d/d%d", root, count, i);
+		if (mkdir(path, 0700) != 0) return 0;
+		for (r = 0; r < 4; ++r)
+		{
+			if (i*100 >= ratios[r]*count) continue;
+			sprintf(path, "%s/n%d/d%d/hits%d", root, count, i, ratios[r]);
+			if (!createFile(path)) return 0;
+		}
+		if (i == 0)
+		{
+			sprintf(path, "%s/n%d/d0", root, count);
+			setenv("XDG_DATA_HOME", path, 1);
+			setenv("XDG_CONFIG_HOME", path, 1);
+			continue;
+		}
+		if (ptr != dirs) *ptr++ = ':';
+		ptr += sprintf(ptr, "%s/n%d/d%d", root, count, i);
+	}
+	setenv("XDG_DATA_DIRS", dirs, 1);
+	setenv("XDG_CONFIG_DIRS", dirs, 1);
+	return 1;
+}
+
+void benchFind(int count)
+{
+	static const char *paths[] = { "hits0", "hits10", "hits50", "hits100" };
+	static const int ratios[] = { 0, 10, 50, 100 };
+	static const char *handles[] = { "NULL handle", "handle", "dirfds handle" };
+	char name[64];
+	xdgHandle h;
+	int p, k;
+
+	for (k = 0; k < 3; ++k)
+	{
+		queryHandle = k == 0 ? NULL : xdgInitHandleEx(&h, k == 2 ? XDG_HANDLE_DIRFDS : 0);
+		if (k && !queryHandle) continue;
+		for (p = 0; p < 4; ++p)
+		{
+			queryPath = paths[p];
+			sprintf(name, "xdgDataFind %d/%d hits, %s", (ratios[p]*count+99)/100, count, handles[k]);
+			run(name, dataFind, count > 10 ? 200 : 2000);
+		}
+		queryPath = paths[2];
+		sprintf(name, "xdgConfigFind %d/%d hits, %s", (ratios[2]*count+99)/100, count, handles[k]);
+		run(name, configFind, count > 10 ? 200 : 2000);
+		if (queryHandle)
+			xdgWipeHandle(queryHandle);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char *tmp;
+	char command[sizeof(root)+16];
+	int ret = 0;
+
+	if (argc > 1) scale = strtoul(argv[1], NULL, 10);
+	if (!scale) scale = 1;
+	/* measure the library, not the disk */
+	if (!(tmp = getenv("XDG_BENCH_DIR")))
+		tmp = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp";
+	snprintf(root, sizeof(root), "%.40s/xdgbench.XXXXXX", tmp);
+	if (!mkdtemp(root))
+	{
+		perror(root);
+		return 1;
+	}
+	setenv("HOME", root, 1);
+
+	if (!setupDirectories(2) || !xdgInitHandle(&handle))
+		ret = 1;
+	else
+	{
+		run("xdgInitHandle + xdgWipeHandle", initAndWipe, 2000);
+		run("xdgUpdateData, unchanged", update, 2000);
+		strcpy(updateDirs[0], getenv("XDG_DATA_DIRS"));
+		sprintf(updateDirs[1], "%s/", updateDirs[0]);
+		run("xdgUpdateData, changed", updateChanged, 2000);
+		setenv("XDG_DATA_DIRS", updateDirs[0], 1);
+		run("xdgDataHome, NULL handle", dataHomeNull, 20000);
+		run("xdgDataHome, handle", dataHomeHandle, 20000);
+		run("xdgSearchableDataDirectories, NULL handle", searchableNull, 20000);
+		run("xdgSearchableDataDirectories, handle", searchableHandle, 20000);
+		xdgWipeHandle(&handle);
+		benchFind(2);
+		if (setupDirectories(10)) benchFind(10); else ret = 1;
+		if (setupDirectories(100)) benchFind(100); else ret = 1;
+		sprintf(makePathBuffer, "%s/mk", root);
+		if (mkdir(makePathBuffer, 0700) == 0)
+		{
+			run("xdgMakePath 32 levels, new", makePathNew, 200);
+			run("xdgMakePath 32 levels, existing", makePathExisting, 2000);
+		}
+		else ret = 1;
+	}
+	if (ret)
+		perror("benchmark setup");
+	snprintf(command, sizeof(command), "rm -rf '%s'", root);
+	if (system(command) != 0)
+		ret = 1;
+	return ret;
+}
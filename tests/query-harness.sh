@@ -1,6 +1,6 @@
 #!/bin/sh
 
-if [ -z "$expected" ]; then
+if [ -z "${expected+set}" ]; then
 	echo "invalid test case, missing \$expected variable" >&2
 fi
 if [ -z "$arguments" ]; then
@@ -0,0 +1,376 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Stress test for concurrent use of a handle, run with "make stress".
+ * Reader threads look files up through one XDG_HANDLE_CONCURRENT handle
+ * while another thread keeps calling xdgUpdateData(). This is repeated
+ * for 1, 2, 4, ... readers up to the first argument (64 by default), each
+ * run lasting the number of milliseconds given as second argument, and
+ * the lookup throughput of every run is reported. Lookups are then made
+ * against thousands of data directories and with relative paths close to
+ * PATH_MAX. Any wrong result makes the program fail, so that it is also
+ * worth running when built with -fsanitize=thread or -fsanitize=address. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+#define MAX_READERS 64
+#define CHECK_INTERVAL 16
+#define LARGE_DIRECTORIES 4000
+#define LONG_COMPONENTS 24
+
+static char root[64];
+static char homes[2][sizeof(root)+8];
+static char dataDir[sizeof(root)+8];
+static char expected[sizeof(dataDir)+16];
+static xdgHandle handle;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int done, failed;
+
+static int finished(int failure)
+{
+	int result;
+	pthread_mutex_lock(&lock);
+	failed |= failure;
+	result = done;
+	pthread_mutex_unlock(&lock);
+	return result;
+}
+
+static void finish(int value)
+{
+	pthread_mutex_lock(&lock);
+	done = value;
+	pthread_mutex_unlock(&lock);
+}
+
+static int createFile(const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file) return 0;
+	fputs("stress\n", file);
+	return fclose(file) == 0;
+}
+
+/* One find and one open, checking that both see consistent data. */
+static int lookup(void)
+{
+	const char *home;
+	char *found;
+	FILE *file;
+	int ticket, ok;
+
+	ticket = xdgBeginRead(&handle);
+	home = xdgDataHome(&handle);
+	ok = strcmp(home, homes[0]) == 0 || strcmp(home, homes[1]) == 0;
+	xdgEndRead(&handle, ticket);
+	if ((found = xdgDataFind("stress/present", &handle)))
+	{
+		ok = ok && strcmp(found, expected) == 0 && !found[strlen(found)+1];
+		free(found);
+	}
+	else
+		ok = 0;
+	if ((file = xdgDataOpen("stress/present", "r", &handle)))
+		fclose(file);
+	else
+		ok = 0;
+	return ok;
+}
+
+void *readLoop(void *arg)
+{
+	unsigned long *lookups = (unsigned long*)arg;
+	int failure = 0, i;
+	while (!finished(failure))
+		for (i = 0; i < CHECK_INTERVAL; ++i)
+		{
+			failure |= !lookup();
+			*lookups += 2;
+		}
+	return NULL;
+}
+
+/* Only this thread touches the environment while readers run. */
+void *updateLoop(void *arg)
+{
+	unsigned long *updates = (unsigned long*)arg;
+	int failure = 0;
+	while (!finished(failure))
+	{
+		setenv("XDG_DATA_HOME", homes[*updates % 2], 1);
+		failure = !xdgUpdateData(&handle);
+		++*updates;
+	}
+	return NULL;
+}
+
+/* Run readers against the handle and report their throughput.
+ * @return Lookups per second, or a negative value on failure. */
+double runReaders(int readers, unsigned long milliseconds, double single)
+{
+	pthread_t threads[MAX_READERS+1];
+	unsigned long lookups[MAX_READERS], updates = 0, total = 0;
+	struct timespec start, end, pause;
+	double seconds, rate;
+	int started, i;
+
+	finish(0);
+	memset(lookups, 0, sizeof(lookups));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	started = pthread_create(&threads[0], NULL, updateLoop, &updates) == 0;
+	for (i = 0; started == i+1 && i < readers; ++i)
+		started += pthread_create(&threads[i+1], NULL, readLoop, &lookups[i]) == 0;
+	pause.tv_sec = milliseconds/1000;
+	pause.tv_nsec = (milliseconds%1000)*1000000;
+	if (started == readers+1)
+		nanosleep(&pause, NULL);
+	finish(1);
+	for (i = 0; i < started; ++i)
+		pthread_join(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (started != readers+1)
+	{
+		fprintf(stderr, "could not start %d readers\n", readers);
+		return -1;
+	}
+	for (i = 0; i < readers; ++i)
+		total += lookups[i];
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+	rate = total/seconds;
+	printf("%2d readers %12.0f lookups/s %6.2fx %10.0f updates/s\n", readers, rate,
+		single > 0 ? rate/single : 1.0, updates/seconds);
+	return failed ? -1 : rate;
+}
+
+int runScaling(int flags, const char *name, int maxReaders, unsigned long milliseconds)
+{
+	double single = 0, rate;
+	int readers, ok = 1;
+
+	setenv("XDG_DATA_HOME", homes[0], 1);
+	if (!xdgInitHandleEx(&handle, flags))
+	{
+		perror(name);
+		return 0;
+	}
+	printf("%s:\n", name);
+	for (readers = 1; ok && readers <= maxReaders; readers *= 2)
+	{
+		if ((rate = runReaders(readers, milliseconds, single)) < 0)
+			ok = 0;
+		else if (readers == 1)
+			single = rate;
+	}
+	xdgWipeHandle(&handle);
+	if (!ok)
+		fprintf(stderr, "%s: concurrent lookups failed\n", name);
+	return ok;
+}
+
+/* Count the items of a directory list. */
+static int countItems(const char * const *items)
+{
+	int count = 0;
+	while (items[count]) ++count;
+	return count;
+}
+
+/* Check that a find result holds exactly the given paths. */
+static int isResult(char *found, const char *first, const char *second)
+{
+	int ok = found && strcmp(found, first) == 0;
+	if (ok && second)
+		ok = strcmp(found+strlen(first)+1, second) == 0 && !found[strlen(first)+strlen(second)+2];
+	else if (ok)
+		ok = !found[strlen(first)+1];
+	free(found);
+	return ok;
+}
+
+int checkLargeList(void)
+{
+	char *list, *ptr;
+	xdgHandle large;
+	int ok, i;
+
+	if (!(list = (char*)malloc(LARGE_DIRECTORIES*(sizeof(root)+16))))
+		return 0;
+	for (ptr = list, i = 0; i < LARGE_DIRECTORIES-1; ++i)
+		ptr += sprintf(ptr, "%s/missing%d:", root, i);
+	strcpy(ptr, dataDir);
+	setenv("XDG_DATA_HOME", homes[0], 1);
+	setenv("XDG_DATA_DIRS", list, 1);
+	free(list);
+
+	ok = isResult(xdgDataFind("stress/present", NULL), expected, NULL);
+	if (!ok)
+		fprintf(stderr, "%d directories: lookup without handle failed\n", LARGE_DIRECTORIES);
+	if (!xdgInitHandleEx(&large, XDG_HANDLE_DIRFDS))
+		ok = 0;
+	else
+	{
+		if (countItems(xdgSearchableDataDirectories(&large)) != LARGE_DIRECTORIES+1 ||
+			!isResult(xdgDataFind("stress/present", &large), expected, NULL))
+		{
+			fprintf(stderr, "%d directories: lookup with handle failed\n", LARGE_DIRECTORIES);
+			ok = 0;
+		}
+		xdgWipeHandle(&large);
+	}
+	if (!xdgInitHandleEx(&large, XDG_HANDLE_PRUNE_MISSING))
+		ok = 0;
+	else
+	{
+		if (countItems(xdgSearchableDataDirectories(&large)) != 2 ||
+			!isResult(xdgDataFind("stress/present", &large), expected, NULL))
+		{
+			fprintf(stderr, "%d directories: pruning missing directories failed\n", LARGE_DIRECTORIES);
+			ok = 0;
+		}
+		xdgWipeHandle(&large);
+	}
+	setenv("XDG_DATA_DIRS", dataDir, 1);
+	return ok;
+}
+
+/* Find the same long path in the home and data directory, so that the
+ * result does not fit into PATH_MAX, and a path longer than PATH_MAX. */
+int checkLongPaths(void)
+{
+	char relative[LONG_COMPONENTS*101+16];
+	char paths[2][sizeof(root)+sizeof(relative)];
+	char tooLong[PATH_MAX+100];
+	char buffer[64];
+	char *ptr, *found;
+	xdgHandle *handles[2];
+	xdgHandle longHandle;
+	size_t needed;
+	int ok = 1, i;
+
+	for (ptr = relative, i = 0; i < LONG_COMPONENTS; ++i)
+	{
+		memset(ptr, 'a'+i, 100);
+		ptr[100] = '/';
+		ptr += 101;
+	}
+	strcpy(ptr, "present");
+	for (i = 0; i < 2; ++i)
+	{
+		sprintf(paths[i], "%s/%s", i ? dataDir : homes[0], relative);
+		*strrchr(paths[i], '/') = 0;
+		if (xdgMakePath(paths[i], 0700) != 0)
+			return 0;
+		paths[i][strlen(paths[i])] = '/';
+		if (!createFile(paths[i]))
+			return 0;
+	}
+	memset(tooLong, 'x', sizeof(tooLong)-1);
+	tooLong[sizeof(tooLong)-1] = 0;
+
+	setenv("XDG_DATA_HOME", homes[0], 1);
+	if (!xdgInitHandle(&longHandle))
+		return 0;
+	handles[0] = NULL;
+	handles[1] = &longHandle;
+	for (i = 0; i < 2; ++i)
+	{
+		if (!isResult(xdgDataFind(relative, handles[i]), paths[0], paths[1]))
+			ok = 0;
+		needed = strlen(paths[0])+strlen(paths[1])+3;
+		if (xdgDataFindInto(relative, XDG_FIND_READABLE, buffer, sizeof(buffer), handles[i]) != needed)
+			ok = 0;
+		if (!(found = xdgDataFind(tooLong, handles[i])) || *found)
+			ok = 0;
+		free(found);
+		if (!ok)
+		{
+			fprintf(stderr, "long paths failed %s handle\n", i ? "with" : "without");
+			break;
+		}
+	}
+	xdgWipeHandle(&longHandle);
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	const char *tmp;
+	char command[sizeof(root)+16];
+	char path[sizeof(dataDir)+8];
+	unsigned long milliseconds = 250;
+	int maxReaders = MAX_READERS;
+	int ret = 0;
+
+	if (argc > 1) maxReaders = atoi(argv[1]);
+	if (maxReaders < 1 || maxReaders > MAX_READERS) maxReaders = MAX_READERS;
+	if (argc > 2) milliseconds = strtoul(argv[2], NULL, 10);
+	if (!(tmp = getenv("TMPDIR")))
+		tmp = "/tmp";
+	snprintf(root, sizeof(root), "%.40s/xdgstress.XXXXXX", tmp);
+	if (!mkdtemp(root))
+	{
+		perror(root);
+		return 1;
+	}
+	sprintf(homes[0], "%s/one", root);
+	sprintf(homes[1], "%s/two", root);
+	sprintf(dataDir, "%s/data", root);
+	sprintf(path, "%s/stress", dataDir);
+	sprintf(expected, "%s/present", path);
+	setenv("HOME", root, 1);
+	setenv("XDG_DATA_DIRS", dataDir, 1);
+
+	if (xdgMakePath(homes[0], 0700) != 0 || xdgMakePath(homes[1], 0700) != 0 ||
+		xdgMakePath(path, 0700) != 0 || !createFile(expected))
+	{
+		perror("stress setup");
+		ret = 1;
+	}
+	else
+	{
+		if (!runScaling(XDG_HANDLE_CONCURRENT, "XDG_HANDLE_CONCURRENT", maxReaders, milliseconds))
+			ret = 1;
+		if (!runScaling(XDG_HANDLE_CONCURRENT | XDG_HANDLE_DIRFDS,
+			"XDG_HANDLE_CONCURRENT | XDG_HANDLE_DIRFDS", maxReaders, milliseconds))
+			ret = 1;
+		if (!checkLargeList())
+			ret = 1;
+		if (!checkLongPaths())
+			ret = 1;
+	}
+	snprintf(command, sizeof(command), "rm -rf '%s'", root);
+	if (system(command) != 0)
+		ret = 1;
+	printf("%s\n", ret ? "stress test failed" : "stress test passed");
+	return ret;
+}
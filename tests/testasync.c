@@ -0,0 +1,117 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+#define LOOKUPS 64
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t finished = PTHREAD_COND_INITIALIZER;
+static int pending;
+static char *results[LOOKUPS];
+
+void found(char *result, int error, void *userData)
+{
+	pthread_mutex_lock(&lock);
+	results[(char**)userData - results] = result;
+	--pending;
+	pthread_cond_signal(&finished);
+	pthread_mutex_unlock(&lock);
+}
+
+/* Compare two results in the format of xdgDataFind() */
+int sameResult(const char *a, const char *b)
+{
+	for (; *a && *b; a += strlen(a)+1, b += strlen(b)+1)
+		if (strcmp(a, b) != 0) return 0;
+	return !*a && !*b;
+}
+
+int main(int argc, char* argv[])
+{
+	static const char *paths[] = { "testasync.c", "nonexistent", "tests/testasync.c", "" };
+	const char *srcdir = getenv("top_srcdir");
+	char dirs[1024];
+	char *expected;
+	xdgHandle handle;
+	int i, ret = 0;
+
+	if (!srcdir) srcdir = "..";
+	snprintf(dirs, sizeof(dirs), "%s/tests:%s:%s/tests", srcdir, srcdir, srcdir);
+	setenv("XDG_DATA_HOME", "/nonexistent", 1);
+	setenv("XDG_DATA_DIRS", dirs, 1);
+	if (!xdgInitHandle(&handle)) return 1;
+
+	pending = LOOKUPS;
+	for (i = 0; i < LOOKUPS; ++i)
+	{
+		if (!xdgDataFindAsync(paths[i%4], i%8 < 4 ? XDG_FIND_READABLE : XDG_FIND_FIRST, found,
+			&results[i], i%2 ? &handle : NULL))
+			return errno == ENOSYS ? 77 : 1;
+	}
+	/* the handle may go away while lookups are in progress */
+	xdgWipeHandle(&handle);
+	pthread_mutex_lock(&lock);
+	while (pending)
+		pthread_cond_wait(&finished, &lock);
+	pthread_mutex_unlock(&lock);
+
+	for (i = 0; i < LOOKUPS; ++i)
+	{
+		expected = xdgDataFindEx(paths[i%4], i%8 < 4 ? XDG_FIND_READABLE : XDG_FIND_FIRST, NULL);
+		if (!results[i] || !expected || !sameResult(results[i], expected))
+		{
+			fprintf(stderr, "asynchronous lookup %d of \"%s\" differs\n", i, paths[i%4]);
+			ret = 1;
+		}
+		free(expected);
+		free(results[i]);
+	}
+
+	/* a lookup without any directory to search still completes */
+	setenv("XDG_DATA_DIRS", "/nonexistent", 1);
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_PRUNE_MISSING)) return 1;
+	pending = 1;
+	if (!xdgDataFindAsync("testasync.c", XDG_FIND_READABLE, found, &results[0], &handle)) return 1;
+	xdgWipeHandle(&handle);
+	pthread_mutex_lock(&lock);
+	while (pending)
+		pthread_cond_wait(&finished, &lock);
+	pthread_mutex_unlock(&lock);
+	if (!results[0] || *results[0])
+	{
+		fprintf(stderr, "asynchronous lookup without directories failed\n");
+		ret = 1;
+	}
+	free(results[0]);
+	return ret;
+}
@@ -0,0 +1,205 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+static char directory[] = "/tmp/testcache.XXXXXX";
+static char file[sizeof(directory)+2];
+static char subdirectory[sizeof(directory)+2];
+static char subfile[sizeof(directory)+4];
+
+/* Check that the first result of finding path is expected (NULL for none). */
+int findPathMatches(xdgHandle *handle, const char *path, const char *expected)
+{
+	char *result = xdgDataFind(path, handle);
+	int ret;
+	if (!result) return 0;
+	ret = expected ? strcmp(result, expected) == 0 : *result == '\0';
+	free(result);
+	return ret;
+}
+
+int findMatches(xdgHandle *handle, const char *expected)
+{
+	return findPathMatches(handle, "a", expected);
+}
+
+int createFile(const char *file)
+{
+	FILE *f = fopen(file, "w");
+	if (!f) return 0;
+	fclose(f);
+	return 1;
+}
+
+int testLookupCache(xdgHandle *handle)
+{
+	struct timespec delay = { 0, 20000000 };
+
+	if (!findMatches(handle, NULL)) return 1;
+	/* misses are cached */
+	if (!createFile(file)) return 2;
+	if (!findMatches(handle, NULL)) return 3;
+	xdgFlushLookupCache(handle);
+	if (!findMatches(handle, file)) return 4;
+	/* hits are cached */
+	unlink(file);
+	if (!findMatches(handle, file)) return 5;
+	/* updating an unchanged environment keeps lookups */
+	if (xdgUpdateData(handle) != XDG_UPDATE_UNCHANGED) return 6;
+	if (!findMatches(handle, file)) return 7;
+	/* rebuilding the data cache flushes them */
+	setenv("XDG_DATA_DIRS", "/nonexistent/other", 1);
+	if (xdgUpdateData(handle) != XDG_UPDATE_REBUILT) return 8;
+	setenv("XDG_DATA_DIRS", "/nonexistent", 1);
+	if (!findMatches(handle, NULL)) return 9;
+	/* entries expire */
+	xdgSetLookupCacheTTL(handle, 10);
+	if (!findMatches(handle, NULL)) return 10;
+	if (!createFile(file)) return 11;
+	nanosleep(&delay, NULL);
+	if (!findMatches(handle, file)) return 12;
+	return 0;
+}
+
+int testWatch(xdgHandle *handle)
+{
+	if (xdgEventFd(handle) < 0) return 0; /* no inotify support */
+	if (!findMatches(handle, NULL)) return 1;
+	if (!findPathMatches(handle, "b/c", NULL)) return 2;
+	if (xdgProcessEvents(handle) != 0) return 3;
+	/* changes in the base directory are noticed */
+	if (!createFile(file)) return 4;
+	if (!findMatches(handle, NULL)) return 5;
+	if (xdgProcessEvents(handle) <= 0) return 6;
+	if (!findMatches(handle, file)) return 7;
+	/* so are changes in subdirectories created later */
+	if (mkdir(subdirectory, 0700) == -1) return 8;
+	if (xdgProcessEvents(handle) <= 0) return 9;
+	if (!findPathMatches(handle, "b/c", NULL)) return 10;
+	if (!createFile(subfile)) return 11;
+	if (xdgProcessEvents(handle) <= 0) return 12;
+	if (!findPathMatches(handle, "b/c", subfile)) return 13;
+	/* directories that are no longer searched are not watched */
+	setenv("XDG_DATA_HOME", subdirectory, 1);
+	if (xdgUpdateData(handle) != XDG_UPDATE_REBUILT) return 14;
+	if (xdgProcessEvents(handle) != 0) return 15;
+	unlink(file);
+	if (xdgProcessEvents(handle) != 0) return 16;
+	unlink(subfile);
+	if (xdgProcessEvents(handle) <= 0) return 17;
+	setenv("XDG_DATA_HOME", directory, 1);
+	return 0;
+}
+
+/* Check whether a file is reported to exist, without checking readability. */
+int existsMatches(xdgHandle *handle, const char *path, const char *expected)
+{
+	char *result = xdgDataFindEx(path, XDG_FIND_EXISTS, handle);
+	int ret;
+	if (!result) return 0;
+	ret = expected ? strcmp(result, expected) == 0 : *result == '\0';
+	free(result);
+	return ret;
+}
+
+int testListings(xdgHandle *handle)
+{
+	/* missing subdirectories are remembered */
+	if (!findPathMatches(handle, "b/c", NULL)) return 1;
+	if (mkdir(subdirectory, 0700) == -1 || !createFile(subfile)) return 2;
+	if (!findPathMatches(handle, "b/c", NULL)) return 3;
+	xdgFlushLookupCache(handle);
+	if (!findPathMatches(handle, "b/c", subfile)) return 4;
+	/* so are the names in a listed directory */
+	if (!findMatches(handle, NULL)) return 5;
+	if (!createFile(file)) return 6;
+	if (!findMatches(handle, NULL)) return 7;
+	if (!existsMatches(handle, "a", NULL)) return 8;
+	xdgFlushLookupCache(handle);
+	if (!findMatches(handle, file)) return 9;
+	/* listed names are only probed if more than existence is asked for */
+	unlink(file);
+	if (!existsMatches(handle, "a", file)) return 10;
+	if (!findMatches(handle, NULL)) return 11;
+	xdgFlushLookupCache(handle);
+	if (!existsMatches(handle, "a", NULL)) return 12;
+	/* listed links are probed, as they may dangle */
+	if (symlink("/nonexistent", file) == -1) return 13;
+	xdgFlushLookupCache(handle);
+	if (!existsMatches(handle, "a", NULL)) return 14;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int ret;
+	xdgHandle handle;
+	if (!mkdtemp(directory)) return 1;
+	sprintf(file, "%s/a", directory);
+	sprintf(subdirectory, "%s/b", directory);
+	sprintf(subfile, "%s/b/c", directory);
+	/* the home directory is the only data directory */
+	setenv("XDG_DATA_HOME", directory, 1);
+	setenv("XDG_DATA_DIRS", "/nonexistent", 1);
+
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_LOOKUP_CACHE)) return 1;
+	if ((ret = testLookupCache(&handle)))
+		fprintf(stderr, "lookup cache check %d failed\n", ret);
+	xdgWipeHandle(&handle);
+	unlink(file);
+
+	if (!ret)
+	{
+		if (!xdgInitHandleEx(&handle, XDG_HANDLE_WATCH)) return 1;
+		if ((ret = testWatch(&handle)))
+			fprintf(stderr, "watch check %d failed\n", ret);
+		xdgWipeHandle(&handle);
+	}
+	unlink(subfile);
+	rmdir(subdirectory);
+	unlink(file);
+
+	if (!ret)
+	{
+		if (!xdgInitHandleEx(&handle, XDG_HANDLE_LISTINGS)) return 1;
+		if ((ret = testListings(&handle)))
+			fprintf(stderr, "listing check %d failed\n", ret);
+		xdgWipeHandle(&handle);
+	}
+
+	unlink(subfile);
+	rmdir(subdirectory);
+	unlink(file);
+	rmdir(directory);
+	return ret;
+}
@@ -0,0 +1,119 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <basedir.h>
+
+static int isString(const char *value, const char *expected)
+{
+	return value && strcmp(value, expected) == 0;
+}
+
+static int testValues(void)
+{
+	xdgHandleValues values;
+	xdgHandle handle;
+	const char * const *dirs;
+	int ret = 0;
+
+	/* nothing is read from the environment */
+	memset(&values, 0, sizeof(values));
+	if (xdgInitHandleFromValues(&handle, 0, &values) || errno != EINVAL) return 1;
+	values.home = "/home/tenant";
+	values.homes[XDG_CONFIG] = "/etc/tenant";
+	values.directories[XDG_DATA] = "/opt/share";
+	if (!xdgInitHandleFromValues(&handle, 0, &values)) return 2;
+	dirs = xdgDataDirectories(&handle);
+	if (!isString(xdgDataHome(&handle), "/home/tenant/.local/share")) ret = 3;
+	else if (!isString(xdgConfigHome(&handle), "/etc/tenant")) ret = 4;
+	else if (xdgRuntimeDirectory(&handle)) ret = 5;
+	else if (!isString(dirs[0], "/opt/share") || dirs[1]) ret = 6;
+	else if (!isString(xdgConfigDirectories(&handle)[0], "/etc/xdg")) ret = 7;
+	else if (!xdgUpdateData(&handle) || !isString(xdgStateHome(&handle), "/home/tenant/.local/state")) ret = 8;
+	xdgWipeHandle(&handle);
+	return ret;
+}
+
+static int testClone(void)
+{
+	xdgHandleValues overrides;
+	xdgHandle handle, clone, tenant;
+	const char * const *dirs;
+	const char *dataHome;
+	int ret = 0;
+
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_DIRFDS)) return 11;
+	if (!xdgCloneHandle(&clone, &handle, NULL))
+	{
+		xdgWipeHandle(&handle);
+		return 12;
+	}
+	memset(&overrides, 0, sizeof(overrides));
+	overrides.homes[XDG_CONFIG] = "/tenant/config";
+	if (!xdgCloneHandle(&tenant, &clone, &overrides))
+	{
+		xdgWipeHandle(&clone);
+		xdgWipeHandle(&handle);
+		return 13;
+	}
+	dataHome = xdgDataHome(&handle);
+	/* unchanged classes are shared rather than copied */
+	if (xdgDataHome(&clone) != dataHome || xdgConfigHome(&clone) != xdgConfigHome(&handle)) ret = 14;
+	else if (xdgDataHome(&tenant) != dataHome) ret = 15;
+	xdgWipeHandle(&handle);
+	xdgWipeHandle(&clone);
+	if (ret)
+	{
+		xdgWipeHandle(&tenant);
+		return ret;
+	}
+	dirs = xdgSearchableConfigDirectories(&tenant);
+	if (!isString(dataHome, "/home/test/.data")) ret = 16;
+	else if (!isString(dirs[0], "/tenant/config") || !isString(dirs[1], "/etc/test") || dirs[2]) ret = 17;
+
+	/* updates read the environment again, but keep the overrides */
+	setenv("XDG_DATA_HOME", "/home/test/.other", 1);
+	if (!ret && !xdgUpdateData(&tenant)) ret = 18;
+	else if (!ret && (!isString(xdgDataHome(&tenant), "/home/test/.other") ||
+		!isString(xdgConfigHome(&tenant), "/tenant/config"))) ret = 19;
+	xdgWipeHandle(&tenant);
+	return ret;
+}
+
+int main(int argc, char* argv[])
+{
+	int ret;
+
+	setenv("HOME", "/home/test", 1);
+	setenv("XDG_DATA_HOME", "/home/test/.data", 1);
+	setenv("XDG_CONFIG_HOME", "/home/test/.config", 1);
+	setenv("XDG_CONFIG_DIRS", "/etc/test", 1);
+	unsetenv("XDG_RUNTIME_DIR");
+	if ((ret = testValues()) || (ret = testClone()))
+		fprintf(stderr, "clone check %d failed\n", ret);
+	return ret;
+}
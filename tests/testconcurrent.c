@@ -0,0 +1,103 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+#define READERS 4
+#define UPDATES 200
+
+static const char *homes[] = { "/home/test/one", "/home/test/two" };
+static xdgHandle handle;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int done, failed;
+
+static int isHome(const char *path)
+{
+	return strcmp(path, homes[0]) == 0 || strcmp(path, homes[1]) == 0;
+}
+
+static int finished(int failure)
+{
+	int result;
+	pthread_mutex_lock(&lock);
+	failed |= failure;
+	result = done;
+	pthread_mutex_unlock(&lock);
+	return result;
+}
+
+/* Check that values obtained inside a read section stay valid until it ends. */
+void *reader(void *arg)
+{
+	const char *home;
+	const char * const *dirs;
+	char *found;
+	int ticket, failure = 0;
+	while (!finished(failure))
+	{
+		ticket = xdgBeginRead(&handle);
+		home = xdgDataHome(&handle);
+		dirs = xdgSearchableDataDirectories(&handle);
+		failure = !isHome(home) || !isHome(dirs[0]);
+		xdgEndRead(&handle, ticket);
+		if ((found = xdgDataFind("nonexistent", &handle)))
+			free(found);
+		else
+			failure = 1;
+	}
+	return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+	pthread_t threads[READERS];
+	int i;
+
+	setenv("XDG_DATA_HOME", homes[0], 1);
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_CONCURRENT))
+		return errno == ENOSYS ? 77 : 1;
+	for (i = 0; i < READERS; ++i)
+		if (pthread_create(&threads[i], NULL, reader, NULL) != 0) return 1;
+	for (i = 0; i < UPDATES; ++i)
+	{
+		setenv("XDG_DATA_HOME", homes[i%2], 1);
+		if (!xdgUpdateData(&handle)) finished(1);
+	}
+	pthread_mutex_lock(&lock);
+	done = 1;
+	pthread_mutex_unlock(&lock);
+	for (i = 0; i < READERS; ++i)
+		pthread_join(threads[i], NULL);
+	xdgWipeHandle(&handle);
+	if (failed)
+		fprintf(stderr, "concurrent reads saw inconsistent data\n");
+	return failed;
+}
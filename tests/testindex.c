@@ -0,0 +1,181 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+static char root[] = "/tmp/testindex.XXXXXX";
+static char path[sizeof(root)+64];
+
+static const char *makePath(const char *relativePath)
+{
+	sprintf(path, "%s/%s", root, relativePath);
+	return path;
+}
+
+static int createFile(const char *relativePath)
+{
+	FILE *f;
+	if (!(f = fopen(makePath(relativePath), "w"))) return 0;
+	fclose(f);
+	return 1;
+}
+
+/* Directories changed just now are not indexed, so pretend they are old. */
+static int backdate(const char *relativePath)
+{
+	struct timeval times[2] = { { 1000000000, 0 }, { 1000000000, 0 } };
+	return utimes(relativePath ? makePath(relativePath) : root, times) == 0;
+}
+
+/* Check that a lookup finds relativePath in the data home, or nothing. */
+static int found(xdgHandle *handle, const char *relativePath, int exists)
+{
+	char *result = xdgDataFind(relativePath, handle);
+	char expected[sizeof(path)];
+	int ok;
+
+	sprintf(expected, "%s/data/%s", root, relativePath);
+	ok = result && (exists ? strcmp(result, expected) == 0 && !result[strlen(result)+1] : !*result);
+	free(result);
+	return ok;
+}
+
+static unsigned long probes(void)
+{
+	xdgStats stats;
+	return xdgGetStats(&stats) ? stats.probes : 0;
+}
+
+/* Find the index file written for the test and leave its path in path. */
+static int findIndex(void)
+{
+	DIR *dir;
+	struct dirent *entry;
+	int count = 0;
+	char name[64];
+
+	if (!(dir = opendir(makePath("cache/libxdg-basedir")))) return 0;
+	while ((entry = readdir(dir)))
+	{
+		if (strncmp(entry->d_name, "index-", 6) == 0 && strlen(entry->d_name) < sizeof(name))
+		{
+			strcpy(name, entry->d_name);
+			++count;
+		}
+	}
+	closedir(dir);
+	sprintf(path, "%s/cache/libxdg-basedir/%s", root, name);
+	return count == 1;
+}
+
+static int testIndex(void)
+{
+	xdgHandle handle;
+	unsigned long before;
+	int fd;
+
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_INDEX)) return 1;
+	if (!found(&handle, "sub/a", 1) || !found(&handle, "b", 1) || !found(&handle, "sub/c", 0)) return 2;
+	if (!xdgSaveIndex(&handle)) return 3;
+	xdgWipeHandle(&handle);
+
+	/* a new handle answers from the index without probing */
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_INDEX)) return 4;
+	before = probes();
+	if (!found(&handle, "sub/a", 1) || !found(&handle, "b", 1) || !found(&handle, "sub/c", 0)) return 5;
+	if (probes() != before) return 6;
+
+	/* creating a file changes the stamp of its directory only */
+	if (!createFile("data/sub/c")) return 7;
+	xdgFlushLookupCache(&handle);
+	before = probes();
+	if (!found(&handle, "b", 1)) return 8;
+	if (probes() != before) return 9;
+	if (!found(&handle, "sub/c", 1) || !found(&handle, "sub/a", 1)) return 10;
+	xdgWipeHandle(&handle);
+
+	/* results depending on a directory changed just now are not saved */
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_INDEX)) return 11;
+	if (!found(&handle, "sub/c", 1)) return 12;
+	xdgWipeHandle(&handle);
+	if (!backdate("data/sub")) return 13;
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_INDEX)) return 14;
+	before = probes();
+	if (!found(&handle, "sub/c", 1)) return 15;
+	if (probes() == before && before) return 16;
+	xdgWipeHandle(&handle);
+
+	/* a damaged index is ignored */
+	if (!findIndex()) return 17;
+	if ((fd = open(path, O_WRONLY)) == -1) return 18;
+	if (ftruncate(fd, 40) == -1) return 18;
+	close(fd);
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_INDEX)) return 19;
+	if (!found(&handle, "sub/a", 1) || !found(&handle, "sub/c", 1)) return 20;
+	xdgWipeHandle(&handle);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	static const char *dirs[] = { "data/sub", "data", "cache/libxdg-basedir", "cache", NULL };
+	char home[sizeof(path)];
+	int ret, i;
+
+	if (!mkdtemp(root)) return 1;
+	if (mkdir(makePath("data"), 0700) == -1 || mkdir(makePath("data/sub"), 0700) == -1 ||
+		mkdir(makePath("cache"), 0700) == -1) return 1;
+	if (!createFile("data/sub/a") || !createFile("data/b")) return 1;
+	if (!backdate("data/sub") || !backdate("data") || !backdate(NULL)) return 1;
+	strcpy(home, makePath("data"));
+	setenv("XDG_DATA_HOME", home, 1);
+	setenv("XDG_DATA_DIRS", makePath("nonexistent"), 1);
+	setenv("XDG_CACHE_HOME", makePath("cache"), 1);
+
+	ret = testIndex();
+	if (ret)
+		fprintf(stderr, "index check %d failed\n", ret);
+
+	unlink(makePath("data/sub/a"));
+	unlink(makePath("data/sub/c"));
+	unlink(makePath("data/b"));
+	if (findIndex())
+		unlink(path);
+	for (i = 0; dirs[i]; ++i)
+		rmdir(makePath(dirs[i]));
+	rmdir(root);
+	return ret;
+}
@@ -0,0 +1,97 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+static char root[] = "/tmp/testmakepath.XXXXXX";
+static char path[sizeof(root)+64];
+
+static const char *makePath(const char *relativePath)
+{
+	sprintf(path, "%s/%s", root, relativePath);
+	return path;
+}
+
+static int isDirectory(const char *relativePath)
+{
+	struct stat st;
+	return stat(makePath(relativePath), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static int testMakePath(void)
+{
+	xdgHandle handle;
+	FILE *f;
+	int ret = 0;
+
+	if (xdgMakePath(makePath("a/b/c"), 0700) != 0 || !isDirectory("a/b/c")) return 1;
+	if (xdgMakePath(makePath("a/b/c"), 0700) != -1 || errno != EEXIST) return 2;
+	if (xdgMakePath(makePath("a/b/c/d/"), 0700) != 0 || !isDirectory("a/b/c/d")) return 3;
+	if (!(f = fopen(makePath("f"), "w"))) return 4;
+	fclose(f);
+	if (xdgMakePath(makePath("f/x/y"), 0700) != -1 || errno != ENOTDIR) return 5;
+
+	/* home directories are created along with the path */
+	setenv("XDG_DATA_HOME", makePath("data"), 1);
+	setenv("XDG_CONFIG_HOME", makePath("config"), 1);
+	setenv("XDG_CACHE_HOME", makePath("cache"), 1);
+	if (xdgDataMakePath("x/y", 0700, NULL) != 0 || !isDirectory("data/x/y")) return 6;
+	if (xdgConfigMakePath("c", 0700, NULL) != 0 || !isDirectory("config/c")) return 7;
+
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_DIRFDS)) return 8;
+	if (xdgDataMakePath("/z/w", 0700, &handle) != 0 || !isDirectory("data/z/w")) ret = 9;
+	else if (xdgDataMakePath("", 0700, &handle) != -1 || errno != EEXIST) ret = 10;
+	else if (xdgConfigMakePath("c/d", 0700, &handle) != 0 || !isDirectory("config/c/d")) ret = 11;
+	else if (xdgCacheMakePath("q", 0700, &handle) != 0 || !isDirectory("cache/q")) ret = 12;
+	/* the cache home did not exist before, so its descriptor is opened again */
+	else if (xdgUpdateData(&handle) != XDG_UPDATE_REBUILT) ret = 13;
+	xdgWipeHandle(&handle);
+	return ret;
+}
+
+int main(int argc, char* argv[])
+{
+	static const char *dirs[] = { "a/b/c/d", "a/b/c", "a/b", "a", "data/x/y", "data/x", "data/z/w",
+		"data/z", "data", "config/c/d", "config/c", "config", "cache/q", "cache", NULL };
+	int ret, i;
+
+	if (!mkdtemp(root)) return 1;
+	ret = testMakePath();
+	if (ret)
+		fprintf(stderr, "make path check %d failed\n", ret);
+
+	unlink(makePath("f"));
+	for (i = 0; dirs[i]; ++i)
+		rmdir(makePath(dirs[i]));
+	rmdir(root);
+	return ret;
+}
@@ -0,0 +1,121 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+static char root[] = "/tmp/testoverlay.XXXXXX";
+static char home[sizeof(root)+8], dirs[sizeof(root)+8];
+static char homeFile[sizeof(root)+16], dirsFile[sizeof(root)+16], homeDir[sizeof(root)+16];
+
+static int writeFile(const char *path, const char *contents)
+{
+	FILE *f = fopen(path, "w");
+	if (!f) return 0;
+	fputs(contents, f);
+	fclose(f);
+	return 1;
+}
+
+static int testOverlay(xdgHandle *handle)
+{
+	xdgFoundFile *files;
+	struct stat st;
+	int ret = 0;
+
+	if (!writeFile(dirsFile, "system\n")) return 1;
+	if (!(files = xdgConfigFindFiles("app.conf", XDG_FIND_READABLE, handle))) return 2;
+	if (!files[0].path || strcmp(files[0].path, dirsFile) != 0 || files[1].path) ret = 3;
+	else if (files[0].size != 7) ret = 4;
+	else if (xdgFilesChanged(files)) ret = 5;
+	free(files);
+	if (ret) return ret;
+
+	/* the home directory comes first */
+	if (!writeFile(homeFile, "home\n")) return 6;
+	if (!(files = xdgConfigFindFiles("app.conf", XDG_FIND_READABLE | XDG_FIND_FIRST, handle))) return 7;
+	if (stat(homeFile, &st) == -1) ret = 8;
+	else if (!files[0].path || strcmp(files[0].path, homeFile) != 0) ret = 9;
+	else if (!files[1].path || strcmp(files[1].path, dirsFile) != 0 || files[2].path) ret = 10;
+	else if (files[0].inode != (unsigned long long)st.st_ino || files[0].size != 5) ret = 11;
+	else if (xdgFilesChanged(files)) ret = 12;
+	/* modified and removed files are noticed */
+	else if (!writeFile(dirsFile, "changed system\n") || !xdgFilesChanged(files)) ret = 13;
+	free(files);
+	if (ret) return ret;
+	if (!(files = xdgConfigFindFiles("app.conf", XDG_FIND_READABLE, handle))) return 14;
+	if (xdgFilesChanged(files)) ret = 15;
+	else if (unlink(homeFile) == -1 || !xdgFilesChanged(files)) ret = 16;
+	free(files);
+	if (ret) return ret;
+
+	/* the probe mode is that of xdgFind() */
+	if (mkdir(homeDir, 0700) == -1) return 17;
+	if (!(files = xdgConfigFindFiles("app.d", XDG_FIND_EXISTS, handle))) return 18;
+	if (!files[0].path || strcmp(files[0].path, homeDir) != 0 || files[1].path) ret = 19;
+	free(files);
+	if (ret) return ret;
+	if (!(files = xdgConfigFindFiles("app.d", XDG_FIND_EXISTS | XDG_FIND_REGULAR, handle))) return 20;
+	if (files[0].path) ret = 21;
+	free(files);
+	rmdir(homeDir);
+	return ret;
+}
+
+int main(int argc, char* argv[])
+{
+	xdgHandle handle;
+	int ret;
+
+	if (!mkdtemp(root)) return 1;
+	sprintf(home, "%s/home", root);
+	sprintf(dirs, "%s/system", root);
+	sprintf(homeFile, "%s/app.conf", home);
+	sprintf(dirsFile, "%s/app.conf", dirs);
+	sprintf(homeDir, "%s/app.d", home);
+	if (mkdir(home, 0700) == -1 || mkdir(dirs, 0700) == -1) return 1;
+	setenv("XDG_CONFIG_HOME", home, 1);
+	setenv("XDG_CONFIG_DIRS", dirs, 1);
+
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_DIRFDS)) return 1;
+	if ((ret = testOverlay(&handle)))
+		fprintf(stderr, "overlay check %d failed\n", ret);
+	xdgWipeHandle(&handle);
+	/* without a handle the environment is searched directly */
+	if (!ret && (ret = testOverlay(NULL)))
+		fprintf(stderr, "overlay check %d without handle failed\n", ret);
+
+	unlink(homeFile);
+	unlink(dirsFile);
+	rmdir(homeDir);
+	rmdir(home);
+	rmdir(dirs);
+	rmdir(root);
+	return ret;
+}
@@ -45,7 +45,152 @@ void printAndFreeStringList(const char * const *strings)
 	free((const char **)strings);
 }
 
-int main(int argc, char *argv[])
+/* Handle used for queries, NULL unless --handle or --default-handle is given. */
+xdgHandle *handle = NULL;
+
+/* Strings and lists returned for a handle belong to its cache. */
+void printQueryString(const char *string)
+{
+	if (handle)
+		printf("%s\n", string);
+	else
+		printAndFreeString(string);
+}
+
+void printQueryStringList(const char * const *strings)
+{
+	const char * const *item;
+	if (!handle)
+	{
+		printAndFreeStringList(strings);
+		return;
+	}
+	for (item = strings; *item; ++item)
+		printf("%s\n", *item);
+}
+
+/* Print every file found for each path of a batch lookup. */
+void printAndFreeResults(char **results, int count)
+{
+	const char *item;
+	int i;
+	if (!results) return;
+	for (i = 0; i < count; ++i)
+		for (item = results[i]; *item; item += strlen(item)+1)
+			printf("%s\n", item);
+	free(results);
+}
+
+void printAndFreePath(char *path)
+{
+	if (!path) printf("(null)\n");
+	else printAndFreeString(path);
+}
+
+/* Print the result of a lookup into a buffer of the given size. */
+void printFoundInto(size_t (*find)(const char*, int, char*, size_t, xdgHandle*),
+	const char *relativePath, const char *size)
+{
+	size_t length = atoi(size);
+	char *buffer = (char*)malloc(length ? length : 1);
+	const char *item;
+	size_t needed = find(relativePath, XDG_FIND_READABLE, buffer, length, handle);
+	if (needed > length)
+		printf("need %lu\n", (unsigned long)needed);
+	else
+		for (item = buffer; *item; item += strlen(item)+1)
+			printf("%s\n", item);
+	free(buffer);
+}
+
+int parseFindFlags(const char *flags)
+{
+	int result = XDG_FIND_READABLE;
+	if (strstr(flags, "exists")) result |= XDG_FIND_EXISTS;
+	if (strstr(flags, "regular")) result |= XDG_FIND_REGULAR;
+	if (strstr(flags, "fopen")) result |= XDG_FIND_FOPEN;
+	return result;
+}
+
+int compareStrings(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* Print the files of an enumeration sorted, as directories list them in any order. */
+void printEnumeration(xdgEnumeration *(*enumerate)(const char*, const char*, int, xdgHandle*),
+	int argc, char *argv[])
+{
+	xdgEnumeration *enumeration;
+	const char *path;
+	char **paths = NULL;
+	int count = 0, flags = XDG_FIND_READABLE, i;
+	if (argc > 2)
+	{
+		flags = parseFindFlags(argv[2]);
+		if (strstr(argv[2], "parallel")) flags |= XDG_ENUMERATE_PARALLEL;
+	}
+	enumeration = enumerate(argv[0], argc > 1 ? argv[1] : NULL, flags, handle);
+	if (!enumeration) return;
+	while ((path = xdgEnumerateNext(enumeration, NULL)))
+	{
+		paths = (char**)realloc(paths, sizeof(char*)*(count+1));
+		paths[count++] = strdup(path);
+	}
+	xdgEnumerateEnd(enumeration);
+	if (count) qsort(paths, count, sizeof(char*), compareStrings);
+	for (i = 0; i < count; ++i)
+		printAndFreeString(paths[i]);
+	free(paths);
+}
+
+void printFirstLineAndClose(FILE *file)
+{
+	char line[256];
+	if (!file) return;
+	if (fgets(line, sizeof(line), file))
+		printf("%s", line);
+	fclose(file);
+}
+
+/* Print the contents of a mapped file, or (null) if none could be mapped. */
+void printMapping(int (*map)(const char*, xdgMapping*, xdgHandle*), const char *relativePath)
+{
+	xdgMapping mapping;
+	if (!map(relativePath, &mapping, handle))
+	{
+		printf("(null)\n");
+		return;
+	}
+	fwrite(mapping.data, 1, mapping.size, stdout);
+	xdgUnmap(&mapping);
+}
+
+/* Print the contents of loaded files, or (null) for those that could not be loaded. */
+void printLoadedFiles(xdgLoadedFile *files, int count)
+{
+	int i;
+	if (!files) return;
+	for (i = 0; i < count; ++i)
+	{
+		if (files[i].data)
+			fwrite(files[i].data, 1, files[i].size, stdout);
+		else
+			printf("(null)\n");
+	}
+	free(files);
+}
+
+int parseHandleFlags(const char *flags)
+{
+	int result = 0;
+	if (strstr(flags, "dirfds")) result |= XDG_HANDLE_DIRFDS;
+	if (strstr(flags, "dedupe")) result |= XDG_HANDLE_DEDUPE;
+	if (strstr(flags, "prune")) result |= XDG_HANDLE_PRUNE_MISSING;
+	return result;
+}
+
+int query(int argc, char *argv[])
 {
 	if (argc < 3)
 		return 1;
@@ -54,33 +199,76 @@ int main(int argc, char *argv[])
 	if (strcmp(datatype, "data") == 0)
 	{
 		if (strcmp(querytype, "home") == 0)
-			printAndFreeString(xdgDataHome(NULL));
+			printQueryString(xdgDataHome(handle));
 		else if (strcmp(querytype, "dirs") == 0)
-			printAndFreeStringList(xdgDataDirectories(NULL));
+			printQueryStringList(xdgDataDirectories(handle));
 		else if (strcmp(querytype, "search") == 0)
-			printAndFreeStringList(xdgSearchableDataDirectories(NULL));
+			printQueryStringList(xdgSearchableDataDirectories(handle));
 		else if (strcmp(querytype, "find") == 0 && argc == 4)
-			printAndFreeString(xdgDataFind(argv[3], NULL));
+			printAndFreeString(xdgDataFind(argv[3], handle));
+		else if (strcmp(querytype, "find") == 0 && argc == 5)
+			printAndFreeString(xdgDataFindEx(argv[3], parseFindFlags(argv[4]), handle));
+		else if (strcmp(querytype, "open") == 0 && argc == 4)
+			printFirstLineAndClose(xdgDataOpen(argv[3], "r", handle));
+		else if (strcmp(querytype, "map") == 0 && argc == 4)
+			printMapping(xdgDataMap, argv[3]);
+		else if (strcmp(querytype, "load") == 0)
+			printLoadedFiles(xdgDataLoadMany((const char * const *)argv+3, argc-3, handle), argc-3);
+		else if (strcmp(querytype, "findinto") == 0 && argc == 5)
+			printFoundInto(xdgDataFindInto, argv[3], argv[4]);
+		else if (strcmp(querytype, "findfirst") == 0 && argc == 4)
+			printAndFreePath(xdgDataFindFirst(argv[3], XDG_FIND_READABLE, handle));
+		else if (strcmp(querytype, "findmany") == 0)
+			printAndFreeResults(xdgDataFindMany((const char * const *)argv+3, argc-3, XDG_FIND_READABLE, handle), argc-3);
+		else if (strcmp(querytype, "enumerate") == 0 && argc >= 4 && argc <= 6)
+			printEnumeration(xdgDataEnumerate, argc-3, argv+3);
 		else
 			return 1;
 	}
 	else if (strcmp(datatype, "config") == 0)
 	{
 		if (strcmp(querytype, "home") == 0)
-			printAndFreeString(xdgConfigHome(NULL));
+			printQueryString(xdgConfigHome(handle));
 		else if (strcmp(querytype, "dirs") == 0)
-			printAndFreeStringList(xdgConfigDirectories(NULL));
+			printQueryStringList(xdgConfigDirectories(handle));
 		else if (strcmp(querytype, "search") == 0)
-			printAndFreeStringList(xdgSearchableConfigDirectories(NULL));
+			printQueryStringList(xdgSearchableConfigDirectories(handle));
 		else if (strcmp(querytype, "find") == 0 && argc == 4)
-			printAndFreeString(xdgConfigFind(argv[3], NULL));
+			printAndFreeString(xdgConfigFind(argv[3], handle));
+		else if (strcmp(querytype, "find") == 0 && argc == 5)
+			printAndFreeString(xdgConfigFindEx(argv[3], parseFindFlags(argv[4]), handle));
+		else if (strcmp(querytype, "open") == 0 && argc == 4)
+			printFirstLineAndClose(xdgConfigOpen(argv[3], "r", handle));
+		else if (strcmp(querytype, "map") == 0 && argc == 4)
+			printMapping(xdgConfigMap, argv[3]);
+		else if (strcmp(querytype, "load") == 0)
+			printLoadedFiles(xdgConfigLoadMany((const char * const *)argv+3, argc-3, handle), argc-3);
+		else if (strcmp(querytype, "findinto") == 0 && argc == 5)
+			printFoundInto(xdgConfigFindInto, argv[3], argv[4]);
+		else if (strcmp(querytype, "findfirst") == 0 && argc == 4)
+			printAndFreePath(xdgConfigFindFirst(argv[3], XDG_FIND_READABLE, handle));
+		else if (strcmp(querytype, "findmany") == 0)
+			printAndFreeResults(xdgConfigFindMany((const char * const *)argv+3, argc-3, XDG_FIND_READABLE, handle), argc-3);
+		else if (strcmp(querytype, "enumerate") == 0 && argc >= 4 && argc <= 6)
+			printEnumeration(xdgConfigEnumerate, argc-3, argv+3);
 		else
 			return 1;
 	}
 	else if (strcmp(datatype, "cache") == 0)
 	{
 		if (strcmp(querytype, "home") == 0)
-			printAndFreeString(xdgCacheHome(NULL));
+			printQueryString(xdgCacheHome(handle));
+		else
+			return 1;
+	}
+	else if (strcmp(datatype, "state") == 0)
+	{
+		if (strcmp(querytype, "home") == 0)
+			printQueryString(xdgStateHome(handle));
+		else if (strcmp(querytype, "search") == 0)
+			printQueryStringList(xdgSearchableDirectories(XDG_STATE, handle));
+		else if (strcmp(querytype, "find") == 0 && argc == 4)
+			printAndFreeString(xdgFind(XDG_STATE, argv[3], XDG_FIND_READABLE, handle));
 		else
 			return 1;
 	}
@@ -88,9 +276,9 @@ int main(int argc, char *argv[])
 	{
 		if (strcmp(querytype, "directory") == 0)
 		{
-			const char *rd = xdgRuntimeDirectory(NULL);
+			const char *rd = xdgRuntimeDirectory(handle);
 			if (!rd) printf("(null)\n");
-			else printAndFreeString(rd);
+			else printQueryString(rd);
 		}
 		else
 			return 1;
@@ -99,3 +287,25 @@ int main(int argc, char *argv[])
 		return 1;
 	return 0;
 }
+
+int main(int argc, char *argv[])
+{
+	xdgHandle handleData;
+	int ret;
+	if (argc > 1 && strcmp(argv[1], "--default-handle") == 0)
+	{
+		if (!(handle = xdgDefaultHandle()))
+			return 1;
+		return query(argc - 1, argv + 1);
+	}
+	if (argc > 1 && strncmp(argv[1], "--handle", 8) == 0)
+	{
+		if (!(handle = xdgInitHandleEx(&handleData, parseHandleFlags(argv[1]))))
+			return 1;
+		++argv, --argc;
+	}
+	ret = query(argc, argv);
+	if (handle)
+		xdgWipeHandle(handle);
+	return ret;
+}
@@ -0,0 +1,103 @@
+/* Copyright (c) 2007 Mark Nevill
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <basedir.h>
+#include <basedir_fs.h>
+
+static char directory[] = "/tmp/teststats.XXXXXX";
+static char file[sizeof(directory)+2];
+
+int testStats(xdgHandle *handle)
+{
+	xdgStats before, after;
+	xdgDirectoryStats dirs[3];
+	FILE *f;
+
+	if (!xdgGetStats(&before)) return 1;
+	free(xdgDataFind("a", handle));
+	free(xdgDataFind("a", handle));
+	free(xdgConfigFind("a", NULL));
+	if (!xdgGetStats(&after)) return 2;
+	if (after.dataLookups != before.dataLookups+2) return 3;
+	if (after.configLookups != before.configLookups+1) return 4;
+	if (after.lookupCacheMisses != before.lookupCacheMisses+1) return 5;
+	if (after.lookupCacheHits != before.lookupCacheHits+1) return 6;
+	if (after.probes <= before.probes) return 7;
+	if (after.allocations <= before.allocations) return 8;
+	if (after.updates != before.updates) return 9;
+
+	/* the file exists in the first of two directories */
+	if (xdgGetDirectoryStats(handle, XDG_DATA, dirs, 3) != 2) return 10;
+	if (strcmp(dirs[0].directory, directory) != 0) return 11;
+	if (dirs[0].hits != 1 || dirs[0].misses != 0) return 12;
+	if (dirs[1].hits != 0 || dirs[1].misses != 1) return 13;
+	if (!(f = xdgDataOpen("a", "r", handle))) return 14;
+	fclose(f);
+	if (xdgGetDirectoryStats(handle, XDG_DATA, dirs, 1) != 2) return 15;
+	if (dirs[0].hits != 2) return 16;
+
+	/* only updates that rebuild the data cache count */
+	if (xdgUpdateData(handle) != XDG_UPDATE_UNCHANGED) return 17;
+	setenv("XDG_DATA_DIRS", "/nonexistent/other", 1);
+	if (xdgUpdateData(handle) != XDG_UPDATE_REBUILT) return 18;
+	if (!xdgGetStats(&after)) return 19;
+	if (after.updates != before.updates+1) return 20;
+	if (xdgGetDirectoryStats(handle, XDG_DATA, dirs, 3) != 2 || dirs[0].hits != 0) return 21;
+	/* invalid classes are rejected */
+	errno = 0;
+	if (xdgGetDirectoryStats(handle, (xdgDirectoryClass)(XDG_RUNTIME+1), dirs, 3) != 0 || errno != EINVAL) return 22;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int ret;
+	xdgStats stats;
+	xdgHandle handle;
+	FILE *f;
+
+	if (!xdgGetStats(&stats))
+		return errno == ENOSYS ? 77 : 1;
+	if (!mkdtemp(directory)) return 1;
+	sprintf(file, "%s/a", directory);
+	if (!(f = fopen(file, "w"))) return 1;
+	fclose(f);
+	setenv("XDG_DATA_HOME", directory, 1);
+	setenv("XDG_DATA_DIRS", "/nonexistent", 1);
+
+	if (!xdgInitHandleEx(&handle, XDG_HANDLE_LOOKUP_CACHE)) return 1;
+	if ((ret = testStats(&handle)))
+		fprintf(stderr, "statistics check %d failed\n", ret);
+	xdgWipeHandle(&handle);
+	unlink(file);
+	rmdir(directory);
+	return ret;
+}